@@ -41,7 +41,10 @@ typedef enum {
     WGM1_fast_pwm_to_FF             = 5,
     WGM1_fast_pwm_to_1FF            = 6,
     WGM1_fast_pwm_to_3FF            = 7,
-    // todo
+    WGM1_phase_freq_correct_pwm_to_ICR = 8,
+    WGM1_phase_freq_correct_pwm_to_OCR = 9,
+    WGM1_phase_correct_pwm_to_ICR   = 10,
+    WGM1_phase_correct_pwm_to_OCR   = 11,
     WGM1_clear_timer_on_compare_match_ICR = 12,
     WGM1_fast_pwm_to_ICR            = 14,
     WGM1_fast_pwm_to_OCR            = 15
@@ -71,13 +74,13 @@ typedef enum {
 static inline void clock_portb_init(ClockSelect cs, WaveformGenerationMode_Clock1 wgm, CompareOutputMode com1a, CompareOutputMode com1b, CompareOutputMode com1c)
 {
     TCCR1A = ((com1a)<<COM1A0) | ((com1b)<<COM1B0) | ((com1c)<<COM1C0) | (((wgm)&3)<<WGM10);
-    TCCR1B = (((wgm)&4?1:0)<<WGM12)  | (cs<<CS10);
+    TCCR1B = (((wgm)&8?1:0)<<WGM13) | (((wgm)&4?1:0)<<WGM12)  | (cs<<CS10);
 }
 
 static inline void clock_portc_init(ClockSelect cs, WaveformGenerationMode_Clock1 wgm, CompareOutputMode com3a, CompareOutputMode com3b, CompareOutputMode com3c)
 {
     TCCR3A = ((com3a)<<COM3A0) | ((com3b)<<COM3B0) | ((com3c)<<COM3C0) | (((wgm)&3)<<WGM10);
-    TCCR3B = (((wgm)&4?1:0)<<WGM12)  | (cs<<CS10);
+    TCCR3B = (((wgm)&8?1:0)<<WGM13) | (((wgm)&4?1:0)<<WGM12)  | (cs<<CS10);
 }
 
 #else
@@ -0,0 +1,36 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Build-time configuration for the Virulent keyboard firmware
+
+#ifndef __CONFIG__
+#define __CONFIG__
+
+/* NROW number of rows
+   NCOL number of columns
+   NKEY = NROW*NCOL */
+#define NROW            6
+#define NCOL            19
+#define NKEY            114
+#define MODES           4
+#define RGB             3
+#define GNDS            3
+
+#define NA              0
+
+#define FADE_TIME 5 // seconds per breath of the main LEDs
+#define LED_HZ 100  // main LED animation frames a second
+
+/* The matrix is sampled from the Timer0 compare interrupt at SCAN_HZ,
+   anywhere from 1000 to 8000 */
+#define SCAN_HZ         1000
+
+/* The scan timer is phase locked to the USB start of frame so a sample is
+   taken SCAN_LEAD_US before each frame begins, leaving that long to debounce
+   it and queue the report ahead of the host's poll */
+#define SCAN_LEAD_US    200
+
+/* Debouncing: a key reports pressed on its first closed reading and
+   released once it has read open for DEBOUNCE_MS in a row */
+#define DEBOUNCE_MS     5
+
+#endif
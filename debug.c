@@ -0,0 +1,69 @@
+/* Debug logging for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "debug.h"
+#include "hal.h"
+#include "usb_keyboard.h"
+
+/* records that did not fit since the last LOG_DROPPED went out */
+static uint16_t debug_dropped = 0;
+
+/* Queue a record of n arguments, preceded by a LOG_DROPPED record when
+   earlier ones were lost, with interrupts off so records logged from the
+   scan interrupt can't land in the middle of another. */
+static void debug_record(uint8_t id, uint8_t n, uint16_t a, uint16_t b, uint16_t c) {
+  uint8_t buf[3+7], len = 0, intr_state;
+
+  intr_state = hal_irq_save();
+  if(debug_dropped) {
+    buf[len++] = LOG_DROPPED<<2 | 1;
+    buf[len++] = debug_dropped;
+    buf[len++] = debug_dropped >> 8;
+  }
+  buf[len++] = id<<2 | n;
+  buf[len++] = a;
+  buf[len++] = a >> 8;
+  buf[len++] = b;
+  buf[len++] = b >> 8;
+  buf[len++] = c;
+  buf[len++] = c >> 8;
+  len -= 2*(3-n);
+  if(usb_debug_write(buf, len) == 0) debug_dropped = 0;
+  else if(debug_dropped < 0xFFFF) debug_dropped++;
+  hal_irq_restore(intr_state);
+}
+
+void debug_log(uint8_t id) {
+  debug_record(id, 0, 0, 0, 0);
+}
+
+void debug_log1(uint8_t id, uint16_t a) {
+  debug_record(id, 1, a, 0, 0);
+}
+
+void debug_log2(uint8_t id, uint16_t a, uint16_t b) {
+  debug_record(id, 2, a, b, 0);
+}
+
+void debug_log3(uint8_t id, uint16_t a, uint16_t b, uint16_t c) {
+  debug_record(id, 3, a, b, c);
+}
@@ -0,0 +1,29 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Compact binary log records over the USB debug interface.
+//
+// A record is one header byte, id<<2 | argument count, then up to three
+// 16 bit little endian arguments.  Zero bytes are padding.  Records are
+// queued with usb_debug_write() and never wait on the USB: one that does
+// not fit is counted and reported with a LOG_DROPPED record once there is
+// room again.  tools/debuglog.py reads the ids and formats below.
+
+#ifndef __DEBUG__
+#define __DEBUG__
+
+#include <stdint.h>
+
+/* Record ids, 1-63, each followed by the format the decoder prints it
+   with, one %u/%d/%x per argument */
+#define LOG_DROPPED     1       // "dropped %u records"
+#define LOG_BOOT        2       // "boot"
+#define LOG_MODE        3       // "mode %u"
+#define LOG_SETTINGS    4       // "settings record %u"
+#define LOG_REMAP       5       // "remap layers %x"
+#define LOG_MACRO       6       // "macro %u"
+
+void debug_log(uint8_t id);
+void debug_log1(uint8_t id, uint16_t a);
+void debug_log2(uint8_t id, uint16_t a, uint16_t b);
+void debug_log3(uint8_t id, uint16_t a, uint16_t b, uint16_t c);
+#endif
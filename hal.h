@@ -0,0 +1,80 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Hardware abstraction for the matrix and LED PWM outputs.
+// hal_avr.c drives the Teensy 2.0++ pins, host/hal_host.c stands in with a
+// mock matrix so the scan/report core can be built and profiled natively.
+// The USB endpoint is reached through usb_keyboard.h, which host/usb_host.c
+// implements by capturing every report instead of transmitting it.
+
+#ifndef __HAL__
+#define __HAL__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+
+/* PWM channels, one per LED colour.  setColor() addresses a group by its
+   first channel plus redIndex/greenIndex/blueIndex.  The GNDS indicators
+   share one set of PWM pins and take turns on them, so each has its own
+   group after the main one. */
+#define PWM_MAIN        0
+#define PWM_IND(n)      (RGB + RGB*(n))
+#define PWM_CHANNELS    (RGB + RGB*GNDS)
+
+// init rows as inputs with pull-ups, columns and LED pins as outputs
+void hal_init(void);
+
+// start Timer1/Timer3 10 bit PWM for the main and indicator LEDs, cycle
+// the indicator grounds off the Timer3 overflow, and call led_tick()
+// LED_HZ times a second off the Timer1 overflow
+void hal_pwm_init(void);
+
+// set the brightness of one PWM channel, 0 off to 255 full; levels are
+// perceptual, the HAL gamma corrects them into the timer's duty cycle
+void hal_pwm_write(uint8_t channel, uint8_t level);
+
+// pull a column low and let the rows settle
+void hal_matrix_select(uint8_t col);
+
+// release a column selected with hal_matrix_select()
+void hal_matrix_unselect(uint8_t col);
+
+// closed keys of the selected column, bit r set for row r
+uint8_t hal_matrix_read_rows(void);
+
+// start Timer0 calling matrix_sample() SCAN_HZ times a second
+void hal_scan_timer_init(void);
+
+// called from the USB start of frame interrupt, nudges the scan timer
+// toward sampling SCAN_LEAD_US before the frame
+void hal_scan_sync(void);
+
+// microseconds from the last matrix sample to the last start of frame,
+// settles at SCAN_LEAD_US once the scan is locked
+uint16_t hal_scan_phase_us(void);
+
+/* Free running timestamp for instrumentation, HAL_TIMER_MHZ ticks a
+   microsecond, wrapping every 32.768 ms.  Differences of two stamps are
+   durations as long as they are shorter than that. */
+#define HAL_TIMER_MHZ   2
+
+// start the timestamp counter
+void hal_timer_init(void);
+
+// current timestamp, safe from interrupts and the main loop
+uint16_t hal_timer_now(void);
+
+/* EEPROM, HAL_EEPROM_SIZE bytes.  A byte write runs in the background for
+   about 3.4 ms and only one can be in flight, so start one only once
+   hal_eeprom_ready() and nothing ever waits on it. */
+#define HAL_EEPROM_SIZE 4096
+
+bool hal_eeprom_ready(void);
+uint8_t hal_eeprom_read(uint16_t addr);
+void hal_eeprom_write(uint16_t addr, uint8_t value);
+
+// disable interrupts, returning the state for hal_irq_restore()
+uint8_t hal_irq_save(void);
+void hal_irq_restore(uint8_t state);
+
+#endif
@@ -0,0 +1,368 @@
+/* Teensy 2.0++ pin assignments and register access for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Copyright (c) 2012 Fredrik Atmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+#include "config.h"
+#include "hal.h"
+#include "matrix.h"
+#include "led.h"
+#include "avrpwm.h"
+
+#if SCAN_HZ < 1000 || SCAN_HZ > 8000
+#error "SCAN_HZ must be between 1000 and 8000"
+#endif
+
+/* Scan timer in Timer0 counts of 64 clocks.  With several scans a frame
+   the lead is met by whichever scan falls closest before the frame. */
+#define SCAN_PERIOD     ((int16_t)(F_CPU / 64 / SCAN_HZ))
+#define SCAN_LEAD       ((int16_t)(SCAN_LEAD_US * (F_CPU / 64 / 1000) / 1000 % SCAN_PERIOD))
+#define SCAN_SLEW       4       // largest correction per frame
+
+#if F_CPU / 8 != HAL_TIMER_MHZ * 1000000UL
+#error "hal_timer_now() runs Timer2 at F_CPU/8, which must be HAL_TIMER_MHZ"
+#endif
+
+#define _DDRB           (uint8_t *const)&DDRB
+#define _DDRC           (uint8_t *const)&DDRC
+#define _DDRD           (uint8_t *const)&DDRD
+#define _DDRE           (uint8_t *const)&DDRE
+#define _DDRF           (uint8_t *const)&DDRF
+
+#define _PINB           (uint8_t *const)&PINB
+#define _PINC           (uint8_t *const)&PINC
+#define _PIND           (uint8_t *const)&PIND
+#define _PINE           (uint8_t *const)&PINE
+#define _PINF           (uint8_t *const)&PINF
+
+#define _PORTB          (uint8_t *const)&PORTB
+#define _PORTC          (uint8_t *const)&PORTC
+#define _PORTD          (uint8_t *const)&PORTD
+#define _PORTE          (uint8_t *const)&PORTE
+#define _PORTF          (uint8_t *const)&PORTF
+
+#define _OCR1A          (volatile uint16_t *const)&OCR1A
+#define _OCR1B          (volatile uint16_t *const)&OCR1B
+#define _OCR1C          (volatile uint16_t *const)&OCR1C
+#define _OCR3A          (volatile uint16_t *const)&OCR3A
+#define _OCR3B          (volatile uint16_t *const)&OCR3B
+#define _OCR3C          (volatile uint16_t *const)&OCR3C
+
+#define _PIN0 0x01
+#define _PIN1 0x02
+#define _PIN2 0x04
+#define _PIN3 0x08
+#define _PIN4 0x10
+#define _PIN5 0x20
+#define _PIN6 0x40
+#define _PIN7 0x80
+
+/* Specifies the ports and pin numbers for the rows.
+   hal_matrix_read_rows() hardcodes this: PINF 2,1,0, PINE 6,7, PINB 0 */
+uint8_t *const  row_ddr[NROW] = { _DDRF,  _DDRF,  _DDRF,  _DDRE,  _DDRE,  _DDRB};
+uint8_t *const row_pull[NROW] = {_PORTF, _PORTF, _PORTF, _PORTE, _PORTE, _PORTB};
+const uint8_t   row_bit[NROW] = { _PIN2,  _PIN1,  _PIN0,  _PIN6,  _PIN7,  _PIN0};
+
+/* Specifies the ports and pin numbers for the indicators lights */
+uint8_t *const  ind_ddr[RGB] = { _DDRC,  _DDRC,  _DDRC};
+uint8_t *const ind_port[RGB] = {_PORTC, _PORTC, _PORTC};
+const uint8_t   ind_bit[RGB] = { _PIN4,  _PIN6,  _PIN5};
+
+/* Specifies the ports and pin numbers for grounds to the indicator lights */
+uint8_t *const  gnd_ddr[GNDS] = { _DDRC,  _DDRC,  _DDRC};
+uint8_t *const gnd_port[GNDS] = {_PORTC, _PORTC, _PORTC};
+const uint8_t   gnd_bit[GNDS] = { _PIN1,  _PIN2,  _PIN3};
+
+/* Specifies the ports and pin numbers for the main lights */
+uint8_t *const  main_ddr[RGB] = { _DDRB,  _DDRB,  _DDRB};
+uint8_t *const main_port[RGB] = {_PORTB, _PORTB, _PORTB};
+const uint8_t   main_bit[RGB] = { _PIN5,  _PIN7,  _PIN6};
+
+/* Compare registers in colour order for the main lights and for whichever
+   indicator currently has its ground pulled low */
+volatile uint16_t *const main_ocr[RGB] = {_OCR1A, _OCR1C, _OCR1B};
+volatile uint16_t *const  ind_ocr[RGB] = {_OCR3C, _OCR3A, _OCR3B};
+
+/* Duty cycles of every indicator colour, PWM_IND(0) first, loaded into
+   ind_ocr by the multiplexer when that indicator's turn comes round */
+static volatile uint16_t ind_duty[RGB*GNDS];
+
+/* Brightness level to 10 bit duty cycle, 1023 * (level/255)^2.2, so equal
+   steps of level look like equal steps of brightness.  Any level above 0
+   gets at least one count. */
+#define PWM_TOP         0x3FF
+static const uint16_t PROGMEM pwm_gamma[256] = {
+     0,    1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    2,    2,
+     2,    3,    3,    3,    4,    4,    5,    5,    6,    6,    7,    7,    8,    9,    9,   10,
+    11,   11,   12,   13,   14,   15,   16,   16,   17,   18,   19,   20,   21,   23,   24,   25,
+    26,   27,   28,   30,   31,   32,   34,   35,   36,   38,   39,   41,   42,   44,   46,   47,
+    49,   51,   52,   54,   56,   58,   60,   61,   63,   65,   67,   69,   71,   73,   76,   78,
+    80,   82,   84,   87,   89,   91,   94,   96,   98,  101,  103,  106,  109,  111,  114,  117,
+   119,  122,  125,  128,  130,  133,  136,  139,  142,  145,  148,  151,  155,  158,  161,  164,
+   167,  171,  174,  177,  181,  184,  188,  191,  195,  198,  202,  206,  209,  213,  217,  221,
+   225,  228,  232,  236,  240,  244,  248,  252,  257,  261,  265,  269,  274,  278,  282,  287,
+   291,  295,  300,  304,  309,  314,  318,  323,  328,  333,  337,  342,  347,  352,  357,  362,
+   367,  372,  377,  382,  387,  393,  398,  403,  408,  414,  419,  425,  430,  436,  441,  447,
+   452,  458,  464,  470,  475,  481,  487,  493,  499,  505,  511,  517,  523,  529,  535,  542,
+   548,  554,  561,  567,  573,  580,  586,  593,  599,  606,  613,  619,  626,  633,  640,  647,
+   653,  660,  667,  674,  681,  689,  696,  703,  710,  717,  725,  732,  739,  747,  754,  762,
+   769,  777,  784,  792,  800,  807,  815,  823,  831,  839,  847,  855,  863,  871,  879,  887,
+   895,  903,  912,  920,  928,  937,  945,  954,  962,  971,  979,  988,  997, 1005, 1014, 1023
+};
+
+/* Specifies the ports and pin numbers for the columns */
+/* Phantom: D1, C7, C6, D4, D0, E6, F0, F1, F4, F1, F6, F7, D7, D6, D1, D2, D3 */
+/* Virulent: F7, F6, F5, F4, F3, B1, B2, B3, B4, E1, E0, D7, D6, D5, D4, D3, D2, D1, D0 */
+uint8_t *const  col_ddr[NCOL] = {
+          _DDRF,  _DDRF,  _DDRF,  _DDRF,  _DDRF,  _DDRB,
+          _DDRB,  _DDRB,  _DDRB,  _DDRE,  _DDRE,  _DDRD,
+          _DDRD,  _DDRD,  _DDRD,  _DDRD,  _DDRD,  _DDRD,
+          _DDRD
+};
+
+uint8_t *const col_port[NCOL] = {
+          _PORTF,  _PORTF,  _PORTF,  _PORTF,  _PORTF,  _PORTB,
+          _PORTB,  _PORTB,  _PORTB,  _PORTE,  _PORTE,  _PORTD,
+          _PORTD,  _PORTD,  _PORTD,  _PORTD,  _PORTD,  _PORTD,
+          _PORTD
+};
+
+const uint8_t   col_bit[NCOL] = {
+          _PIN7,  _PIN6,  _PIN5,  _PIN4,  _PIN3,  _PIN1,
+          _PIN2,  _PIN3,  _PIN4,  _PIN1,  _PIN0,  _PIN7,
+          _PIN6,  _PIN5,  _PIN4,  _PIN3,  _PIN2,  _PIN1,
+          _PIN0
+};
+
+void hal_init(void) {
+  // init rows for input
+  for(uint8_t row=0; row<NROW; row++) {
+    *row_ddr[row] &= ~row_bit[row];
+    *row_pull[row] |= row_bit[row];
+  }
+  // init cols for output
+  for(uint8_t col=0; col<NCOL; col++) {
+    *col_ddr[col] |= col_bit[col];
+    *col_port[col] |= col_bit[col];
+  }
+  // init indicators as outputs
+  for(uint8_t indicator=0; indicator<RGB; indicator++) {
+    *ind_ddr[indicator] |= ind_bit[indicator];
+    *ind_port[indicator] |= ind_bit[indicator];
+  }
+  // init indicators' grounds as outputs
+  for(uint8_t gnd=0; gnd<GNDS; gnd++) {
+    *gnd_ddr[gnd] |= gnd_bit[gnd];
+    *gnd_port[gnd] |= gnd_bit[gnd];     // off until multiplexed
+  }
+  // init main keyboard lights
+  for(uint8_t mainpin=0; mainpin<RGB; mainpin++) {
+    *main_ddr[mainpin] |= main_bit[mainpin];
+    *main_port[mainpin] |= main_bit[mainpin];
+  }
+}
+
+/* Timer1 overflows once a PWM cycle, at the bottom of the phase correct
+   slope; every LED_TICK_DIV of them is one animation frame. */
+#define LED_TICK_DIV    (F_CPU / (2UL * PWM_TOP) / LED_HZ)
+
+#if LED_TICK_DIV < 1 || LED_TICK_DIV > 255
+#error "LED_HZ out of range for the PWM frequency"
+#endif
+
+/* 10 bit PWM, 7.8 kHz at CS_clkio.  The indicators run phase and frequency
+   correct with the same top, which latches new compare values at the
+   bottom of the slope, the same point the overflow interrupt swaps the
+   ground.  Every colour output is low there unless fully on, so moving to
+   the next indicator never shows one cycle of the previous one's colour. */
+void hal_pwm_init(void) {
+  for(uint8_t i=0; i<RGB*GNDS; i++) ind_duty[i] = PWM_TOP;
+  for(uint8_t i=0; i<RGB; i++) *ind_ocr[i] = PWM_TOP;
+  clock_portb_init(CS_clkio, WGM1_phase_correct_pwm_to_3FF, COM_pwm_normal, COM_pwm_normal, COM_pwm_normal);
+  ICR3 = PWM_TOP;
+  clock_portc_init(CS_clkio, WGM1_phase_freq_correct_pwm_to_ICR, COM_pwm_normal, COM_pwm_normal, COM_pwm_normal);
+  TIMSK1 = (1<<TOIE1);
+  TIMSK3 = (1<<TOIE3);
+}
+
+/* One indicator per PWM cycle, so each is refreshed at 7.8 kHz / GNDS,
+   2.6 kHz, for a third of the time.  The compare values written here are
+   for the next indicator and take effect at the next bottom. */
+ISR(TIMER3_OVF_vect)
+{
+  static uint8_t lit, next = 1;
+  const volatile uint16_t *duty;
+
+  *gnd_port[lit] |= gnd_bit[lit];
+  lit = next;
+  *gnd_port[lit] &= ~gnd_bit[lit];
+  if(++next == GNDS) next = 0;
+  duty = &ind_duty[RGB*next];
+  *ind_ocr[redIndex]   = duty[redIndex];
+  *ind_ocr[greenIndex] = duty[greenIndex];
+  *ind_ocr[blueIndex]  = duty[blueIndex];
+}
+
+ISR(TIMER1_OVF_vect)
+{
+  static uint8_t div;
+
+  if(++div < LED_TICK_DIV) return;
+  div = 0;
+  // a frame takes far less than the 10 ms to the next one, but longer
+  // than the scan and USB interrupts should wait, so let them in
+  sei();
+  led_tick();
+}
+
+/* The outputs are high while the counter is above OCR, so the LED is lit
+   for PWM_TOP - OCR counts of each cycle.  The 16 bit write goes through
+   the timer's TEMP register, or is read by the multiplexer, hence
+   interrupts off. */
+void hal_pwm_write(uint8_t channel, uint8_t level) {
+  uint16_t ocr = PWM_TOP - pgm_read_word(&pwm_gamma[level]);
+  uint8_t intr_state = SREG;
+
+  cli();
+  if(channel < PWM_IND(0)) *main_ocr[channel - PWM_MAIN] = ocr;
+  else ind_duty[channel - PWM_IND(0)] = ocr;
+  SREG = intr_state;
+}
+
+void hal_matrix_select(uint8_t col) {
+  *col_port[col] &= ~col_bit[col];
+  _delay_us(1);
+}
+
+void hal_matrix_unselect(uint8_t col) {
+  *col_port[col] |= col_bit[col];
+}
+
+// three port reads instead of six table lookups; rows are active low
+uint8_t hal_matrix_read_rows(void) {
+  uint8_t f = ~PINF, e = ~PINE, b = ~PINB;
+  return ((f >> 2) & 0x01) | (f & 0x02) | ((f << 2) & 0x04)
+       | ((e >> 3) & 0x18) | ((b << 5) & 0x20);
+}
+
+// Timer0 in CTC mode counting at F_CPU/64, so OCR0A fits for 1-8 kHz
+void hal_scan_timer_init(void) {
+  TCCR0A = (1<<WGM01);
+  TCCR0B = (1<<CS01) | (1<<CS00);
+  OCR0A = F_CPU / 64 / SCAN_HZ - 1;
+  TIMSK0 = (1<<OCIE0A);
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+  matrix_sample();
+}
+
+/* TCNT0 at the start of frame is how long ago the last sample was taken.
+   Moving TCNT0 by the error stretches or shortens the current scan period,
+   by at most SCAN_SLEW counts a frame so interrupt latency on one frame
+   can't jerk the schedule around.  That also covers the drift of a
+   SCAN_HZ that doesn't divide the frame evenly. */
+static volatile uint8_t scan_phase;
+
+void hal_scan_sync(void) {
+  uint8_t phase = TCNT0;
+  int16_t err, t;
+
+  scan_phase = phase;
+  err = (int16_t)phase - SCAN_LEAD;
+  if(err > SCAN_PERIOD/2) err -= SCAN_PERIOD;
+  if(err < -(SCAN_PERIOD/2)) err += SCAN_PERIOD;
+  if(err > SCAN_SLEW) err = SCAN_SLEW;
+  if(err < -SCAN_SLEW) err = -SCAN_SLEW;
+  if(err == 0) return;
+  // only while the new count stays clear of the compare match, which a
+  // write to TCNT0 would block for one timer clock
+  t = (int16_t)TCNT0 - err;
+  if(t >= 0 && t < OCR0A) TCNT0 = t;
+}
+
+// a Timer0 count is a whole number of microseconds at the 8 and 16 MHz
+// clocks, so the phase is a product that cannot overflow
+#if 64000000UL % F_CPU
+#error "hal_scan_phase_us() needs F_CPU to divide 64 MHz"
+#endif
+uint16_t hal_scan_phase_us(void) {
+  return scan_phase * (uint16_t)(64000000UL / F_CPU);
+}
+
+/* Timer2 counts at F_CPU/8 and its overflow interrupt supplies the high
+   byte, so a timestamp costs two register reads and no 16 bit timer
+   has to be taken from the LEDs. */
+static volatile uint8_t timer_high;
+
+void hal_timer_init(void) {
+  TCCR2A = 0;
+  TCCR2B = (1<<CS21);
+  TIMSK2 = (1<<TOIE2);
+}
+
+ISR(TIMER2_OVF_vect)
+{
+  timer_high++;
+}
+
+uint16_t hal_timer_now(void) {
+  uint8_t intr_state = SREG, hi, lo;
+
+  cli();
+  hi = timer_high;
+  lo = TCNT2;
+  // overflowed since interrupts went off, the ISR hasn't counted it yet
+  if((TIFR2 & (1<<TOV2)) && lo < 0x80) hi++;
+  SREG = intr_state;
+  return (uint16_t)hi << 8 | lo;
+}
+
+uint8_t hal_irq_save(void) {
+  uint8_t intr_state = SREG;
+  cli();
+  return intr_state;
+}
+
+void hal_irq_restore(uint8_t state) {
+  SREG = state;
+}
+
+bool hal_eeprom_ready(void) {
+  return eeprom_is_ready() ? true : false;
+}
+
+uint8_t hal_eeprom_read(uint16_t addr) {
+  return eeprom_read_byte((const uint8_t *)addr);
+}
+
+// returns as soon as the write has started, eeprom_write_byte() only
+// waits for a previous write, and the caller has checked there is none
+void hal_eeprom_write(uint16_t addr, uint8_t value) {
+  eeprom_write_byte((uint8_t *)addr, value);
+}
@@ -0,0 +1,12 @@
+// Host stand-in for avr-libc's <avr/pgmspace.h>: flash is ordinary memory.
+
+#ifndef __HOST_PGMSPACE__
+#define __HOST_PGMSPACE__
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_word(p)    (*(const uint16_t *)(p))
+#endif
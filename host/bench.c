@@ -0,0 +1,150 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Host microbenchmark for the matrix scan and report path.
+//
+// usage: bench [-b] [-t] [-d file] [-m max_idle_ns] [scans]
+//   -b   the host selects the boot protocol (6 key reports) instead of NKRO
+//   -d   write the debug interface stream to file, see tools/debuglog.py
+//   -t   print every captured HID report of a short typing run and exit
+//   -m   exit non-zero if an idle scan costs more than max_idle_ns
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "host.h"
+#include "../keyboard.h"
+#include "../matrix.h"
+#include "../layer.h"
+#include "../stats.h"
+
+#define DEFAULT_SCANS   1000000UL
+#define HOLD_SCANS      24      // how long each typed key stays down
+#define STRIDE_SCANS    8       // scans between successive key presses
+
+/* Letter keys of the 50-key layout (cols 7-15, rows 1-3) */
+static uint8_t typing_keys[27];
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* One scan per scan timer tick, so HOLD_SCANS must exceed the debounce
+   window measured in ticks */
+static void typing_step(unsigned long scan) {
+  unsigned long n = sizeof(typing_keys);
+  if(scan % STRIDE_SCANS) return;
+
+  host_matrix[typing_keys[(scan / STRIDE_SCANS) % n]] = true;
+  if(scan >= HOLD_SCANS)
+    host_matrix[typing_keys[((scan - HOLD_SCANS) / STRIDE_SCANS) % n]] = false;
+}
+
+/* What the scan timer interrupt and the main loop do for one tick */
+static void scan(void) {
+  matrix_sample();
+  matrix_task();
+}
+
+static void reset(void) {
+
+  hal_init();
+  matrix_init();
+  layer_init();
+  keyboard_init();
+  stats_reset();
+  for(unsigned long i=0; i<4; i++) scan();
+  host_report_count = 0;
+}
+
+// the on-device histograms of the typing run, as tools/stats.py shows them
+static void print_stats(void) {
+  static const char *names[STATS_COUNT] = { "scan", "pass", "queue", "latency" };
+  uint8_t report[STATS_REPORT_SIZE], h, k, *p;
+  uint16_t v[5];
+
+  stats_report(report);
+  printf("%-8s %8s %8s %8s %8s %8s  (us)\n", "", "count", "min", "max", "p50", "p99");
+  for(h=0; h<STATS_COUNT; h++) {
+    p = report + 2 + h*10;
+    for(k=0; k<5; k++) v[k] = p[2*k] | p[2*k+1] << 8;
+    printf("%-8s %8u %8.1f %8.1f %8.1f %8.1f\n", names[h], v[0],
+           (double)v[1] / HAL_TIMER_MHZ, (double)v[2] / HAL_TIMER_MHZ,
+           (double)v[3] / HAL_TIMER_MHZ, (double)v[4] / HAL_TIMER_MHZ);
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long scans = DEFAULT_SCANS, i, reports;
+  double max_idle_ns = 0, t0, idle_ns, typing_ns, typing_s;
+  uint8_t col, row, n = 0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "btd:m:")) != -1) {
+    switch(opt) {
+      case 'b':
+        host_protocol = 0;
+        break;
+      case 't':
+        host_trace = true;
+        scans = 40 * STRIDE_SCANS;
+        break;
+      case 'd':
+        host_debug = fopen(optarg, "wb");
+        if(!host_debug) {
+          perror(optarg);
+          return 2;
+        }
+        break;
+      case 'm':
+        max_idle_ns = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-b] [-t] [-d file] [-m max_idle_ns] [scans]\n", argv[0]);
+        return 2;
+    }
+  }
+  if(optind < argc) scans = strtoul(argv[optind], NULL, 0);
+
+  for(col=7; col<=15; col++)
+    for(row=1; row<=3; row++)
+      typing_keys[n++] = col*NROW+row;
+
+  if(host_trace) {
+    reset();
+    for(i=0; i<scans; i++) {
+      typing_step(i);
+      scan();
+    }
+    return 0;
+  }
+
+  reset();
+  t0 = now_ns();
+  for(i=0; i<scans; i++) scan();
+  idle_ns = (now_ns() - t0) / scans;
+
+  reset();
+  t0 = now_ns();
+  for(i=0; i<scans; i++) {
+    typing_step(i);
+    scan();
+  }
+  typing_s = (now_ns() - t0) / 1e9;
+  typing_ns = typing_s * 1e9 / scans;
+  reports = host_report_count;
+
+  printf("idle scan:   %8.1f ns/scan\n", idle_ns);
+  printf("typing scan: %8.1f ns/scan\n", typing_ns);
+  printf("reports:     %8lu (%.0f reports/s)\n", reports, reports / typing_s);
+  print_stats();
+
+  if(max_idle_ns > 0 && idle_ns > max_idle_ns) {
+    fprintf(stderr, "idle scan %.1f ns exceeds %.1f ns\n", idle_ns, max_idle_ns);
+    return 1;
+  }
+  return 0;
+}
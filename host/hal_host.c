@@ -0,0 +1,84 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Host implementation of hal.h backed by an in-memory switch matrix
+
+#include <time.h>
+#include "host.h"
+
+bool host_matrix[NKEY];
+uint8_t host_pwm[PWM_CHANNELS];
+uint8_t host_eeprom[HAL_EEPROM_SIZE];
+unsigned long host_eeprom_writes;
+uint16_t host_timer_skew;
+
+static uint8_t selected;
+
+void host_matrix_clear(void) {
+  for(uint8_t i=0; i<NKEY; i++) host_matrix[i] = false;
+}
+
+void hal_init(void) {
+  host_matrix_clear();
+}
+
+void hal_pwm_init(void) {
+}
+
+void hal_pwm_write(uint8_t channel, uint8_t level) {
+  host_pwm[channel] = level;
+}
+
+void hal_matrix_select(uint8_t col) {
+  selected = col;
+}
+
+void hal_matrix_unselect(uint8_t col) {
+}
+
+uint8_t hal_matrix_read_rows(void) {
+  uint8_t row, rows = 0;
+  for(row=0; row<NROW; row++)
+    if(host_matrix[selected*NROW+row]) rows |= 1<<row;
+  return rows;
+}
+
+// the bench calls matrix_sample() itself, once per simulated tick
+void hal_scan_timer_init(void) {
+}
+
+void hal_scan_sync(void) {
+}
+
+uint16_t hal_scan_phase_us(void) {
+  return 0;
+}
+
+void hal_timer_init(void) {
+}
+
+uint16_t hal_timer_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint16_t)((ts.tv_sec * 1000000000ULL + ts.tv_nsec) * HAL_TIMER_MHZ / 1000)
+         + host_timer_skew;
+}
+
+uint8_t hal_irq_save(void) {
+  return 0;
+}
+
+void hal_irq_restore(uint8_t state) {
+}
+
+bool hal_eeprom_ready(void) {
+  return true;
+}
+
+uint8_t hal_eeprom_read(uint16_t addr) {
+  return host_eeprom[addr];
+}
+
+void hal_eeprom_write(uint16_t addr, uint8_t value) {
+  host_eeprom[addr] = value;
+  host_eeprom_writes++;
+}
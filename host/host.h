@@ -0,0 +1,53 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Mock matrix and USB capture for the host-native build
+
+#ifndef __HOST__
+#define __HOST__
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../config.h"
+#include "../util.h"
+#include "../hal.h"
+#include "../usb_keyboard.h"
+
+#define HOST_REPORT_LOG 64
+
+/* Mock matrix: true where the switch at key_id = col*NROW+row is closed */
+extern bool host_matrix[NKEY];
+
+/* Last brightness level written to each PWM channel */
+extern uint8_t host_pwm[PWM_CHANNELS];
+
+/* EEPROM contents, all zero (no settings) at start, and how many byte
+   writes they have had */
+extern uint8_t host_eeprom[HAL_EEPROM_SIZE];
+extern unsigned long host_eeprom_writes;
+
+/* Added to hal_timer_now(), a test adds to it to let time pass */
+extern uint16_t host_timer_skew;
+
+/* Largest report, the NKRO bitmap plus its modifier byte */
+#define HOST_REPORT_SIZE (NKRO_KEYS_BYTES+1)
+
+/* Protocol the mock host selected, 0=boot, 1=report (NKRO, the default) */
+extern uint8_t host_protocol;
+
+/* Every report passed to usb_keyboard_send() lands here.  Boot protocol:
+   byte 0 is the modifier byte, 1 is reserved, 2..7 are the key codes.
+   Report protocol: bit n is usage n, byte 28 is the modifier byte. */
+extern uint8_t host_reports[HOST_REPORT_LOG][HOST_REPORT_SIZE];
+extern unsigned long host_report_count;
+
+/* What usb_frame() returns, advance it to let a macro step */
+extern uint8_t host_frame;
+
+/* Print each report as it is captured */
+extern bool host_trace;
+
+/* Where the debug interface output goes, nowhere when NULL */
+extern FILE *host_debug;
+
+void host_matrix_clear(void);
+#endif
@@ -0,0 +1,420 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Checks of the report path: keys go into host_matrix, one scan is a
+// matrix_sample() and a matrix_task(), and the reports usb_host.c
+// captured are compared with what the host should have seen.
+//
+// usage: keyboardtest
+//   exits non-zero and says which check failed if any does
+
+#include <stdio.h>
+#include "host.h"
+#include "../keyboard.h"
+#include "../matrix.h"
+#include "../layer.h"
+#include "../remap.h"
+#include "../macro.h"
+
+/* Scans a key has to read open before it is released, as in matrix.c */
+#define DEBOUNCE_TICKS  (DEBOUNCE_MS * SCAN_HZ / 1000)
+
+/* key_ids of keymap.txt, col*NROW+row */
+#define K_LAYER0_A      38      // KEY_A on layer 0
+#define K_LAYER0_S      44
+#define K_LAYER0_D      50
+#define K_LAYER0_F      56
+#define K_LAYER0_G      62
+#define K_LAYER0_H      68
+#define K_LAYER0_J      74
+#define K_LAYER1_Z      1       // KEY_Z on layer 1, doubled by K_LAYER1_Z2
+#define K_LAYER1_Z2     43
+#define K_LAYER1_SHIFT  18      // KEY_LEFTSHIFT on layer 1, and K_LAYER1_SHIFT2
+#define K_LAYER1_SHIFT2 54
+#define K_LAYER2_SPACE  54      // KEY_SPACE on layer 2
+#define K_DF            31      // DF(1), DF(2), DF(0) on layers 0, 1, 2, TRNS on 3
+#define K_MO3           37      // MO(3), TRNS on layer 3
+#define K_LAYER3_TILDE  32      // KEY_ENTER, S(KEY_TILDE) on layer 3
+#define K_LAYER3_AT     44      // KEY_S, S(KEY_2) on layer 3
+#define K_LAYER3_HASH   50      // KEY_D, S(KEY_3) on layer 3
+#define K_LAYER0_ALT    48      // KEY_LEFTALT on layer 0
+#define K_SPARE         0       // NA on every layer, for bind()
+#define K_SPARE2        6
+
+static int failures = 0;
+
+static void check(const char *what, unsigned long got, unsigned long want) {
+  if(got == want) return;
+  printf("FAIL %s: %lu, expected %lu\n", what, got, want);
+  failures++;
+}
+
+/* What the scan timer interrupt and the main loop do for one tick */
+static void scan(void) {
+  matrix_sample();
+  matrix_task();
+}
+
+static void press(uint8_t key_id) {
+  host_matrix[key_id] = true;
+  scan();
+}
+
+// open the key and scan until the release has gone out
+static void release(uint8_t key_id) {
+  host_matrix[key_id] = false;
+  for(uint8_t i=0; i<=DEBOUNCE_TICKS; i++) scan();
+}
+
+static void reset(void) {
+  hal_init();
+  matrix_init();
+  layer_init();
+  keyboard_init();
+  host_protocol = 1;
+  scan();
+  host_report_count = 0;
+}
+
+static const uint8_t *last_report(void) {
+  return host_reports[(host_report_count - 1) % HOST_REPORT_LOG];
+}
+
+// NKRO: usage's bit in the last report
+static unsigned long has(uint8_t usage) {
+  return host_report_count && last_report()[usage>>3] >> (usage&7) & 1;
+}
+
+// NKRO: modifier byte of the last report
+static unsigned long mods(void) {
+  return host_report_count ? last_report()[NKRO_KEYS_BYTES] : 0;
+}
+
+// every byte of the last report zero, the n bytes of its protocol
+static unsigned long all_up(void) {
+  uint8_t n = host_protocol ? HOST_REPORT_SIZE : 8;
+  for(uint8_t i=0; i<n; i++) if(last_report()[i]) return 0;
+  return 1;
+}
+
+// put code on key_id of a layer through the remap mailbox, as remap.py
+// set does; RESET takes it off again
+static void remap_command(uint8_t cmd, uint8_t layer, uint8_t key_id, Keycode code) {
+  uint8_t report[REMAP_REPORT_SIZE] = { cmd, 1, layer, key_id, code, code >> 8 };
+  remap_request(report);
+  remap_task();
+  remap_reply(report);
+  check("remap command", report[2], REMAP_OK);
+}
+
+static void bind(uint8_t layer, uint8_t key_id, Keycode code) {
+  remap_command(REMAP_CMD_SET, layer, key_id, code);
+}
+
+static void unbind(void) {
+  remap_command(REMAP_CMD_RESET, 0xFF, 0, 0);
+}
+
+static void test_press_release(void) {
+  reset();
+  press(K_LAYER0_A);
+  check("press, one report", host_report_count, 1);
+  check("press, KEY_A in it", has(KEY_A), 1);
+  release(K_LAYER0_A);
+  check("release, one report more", host_report_count, 2);
+  check("release, all up", all_up(), 1);
+}
+
+/* Layer 1 has KEY_Z and KEY_LEFTSHIFT twice.  Whichever key of a pair
+   goes up first, the usage stays until the other does. */
+static void test_doubled_keys(void) {
+  reset();
+  layer_default = 1;
+  layer_update();
+  press(K_LAYER1_Z);
+  press(K_LAYER1_Z2);
+  check("second Z, no new report", host_report_count, 1);
+  release(K_LAYER1_Z);
+  check("first Z up, no report", host_report_count, 1);
+  check("first Z up, Z still down", has(KEY_Z), 1);
+  release(K_LAYER1_Z2);
+  check("second Z up, Z gone", has(KEY_Z), 0);
+  check("second Z up, one report", host_report_count, 2);
+
+  press(K_LAYER1_SHIFT);
+  press(K_LAYER1_SHIFT2);
+  release(K_LAYER1_SHIFT2);
+  check("one shift up, shift still down", mods(), KEY_SHIFT);
+  release(K_LAYER1_SHIFT);
+  check("both shifts up", mods(), 0);
+  check("shift pair, two reports", host_report_count, 4);
+  layer_init();
+}
+
+/* Seven letters down: the 6 key report keeps the newest six, the NKRO one
+   all seven.  When one of the six goes up the oldest comes back. */
+static void test_rollover(void) {
+  static const uint8_t keys[7] = { K_LAYER0_A, K_LAYER0_S, K_LAYER0_D, K_LAYER0_F,
+                                   K_LAYER0_G, K_LAYER0_H, K_LAYER0_J };
+  static const uint8_t usages[7] = { KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_H, KEY_J };
+  static const uint8_t six[6] = { KEY_J, KEY_H, KEY_G, KEY_F, KEY_D, KEY_S };
+  static const uint8_t refilled[6] = { KEY_J, KEY_G, KEY_F, KEY_D, KEY_S, KEY_A };
+  uint8_t i;
+
+  reset();
+  host_protocol = 0;
+  for(i=0; i<7; i++) press(keys[i]);
+  for(i=0; i<6; i++) check("6 key, newest first", last_report()[2+i], six[i]);
+  release(K_LAYER0_H);
+  for(i=0; i<6; i++) check("6 key, A back in the last slot", last_report()[2+i], refilled[i]);
+  for(i=0; i<7; i++) if(keys[i] != K_LAYER0_H) release(keys[i]);
+  check("6 key, all up", all_up(), 1);
+
+  reset();
+  for(i=0; i<7; i++) press(keys[i]);
+  for(i=0; i<7; i++) check("NKRO, all seven", has(usages[i]), 1);
+  for(i=0; i<7; i++) release(keys[i]);
+  check("NKRO, all up", all_up(), 1);
+}
+
+/* A usage set and cleared again before the send leaves the report as it
+   was, so nothing goes out */
+static void test_no_repeat(void) {
+  reset();
+  press(K_LAYER0_A);
+  keyboard_down(KEY_C);
+  keyboard_up(KEY_C);
+  send();
+  check("set and cleared, no report", host_report_count, 1);
+  check("set and cleared, nothing left dirty", report_dirty, 0);
+  release(K_LAYER0_A);
+}
+
+/* The layer is let go before the key: the key still sends what it was
+   pressed as and the release leaves nothing down */
+static void test_layer_released_first(void) {
+  reset();
+  press(K_MO3);
+  check("MO(3) held, layer 3 on", layer_active, 1<<3);
+  press(K_LAYER3_TILDE);
+  check("layer 3 key, tilde", has(KEY_TILDE), 1);
+  check("layer 3 key, shifted", mods(), KEY_SHIFT);
+  release(K_MO3);
+  check("MO(3) up, layer 3 off", layer_active, 0);
+  check("MO(3) up, no report", host_report_count, 1);
+  release(K_LAYER3_TILDE);
+  check("key up after its layer, all up", all_up(), 1);
+  check("key up after its layer, one report", host_report_count, 2);
+}
+
+static void tap(uint8_t key_id) {
+  press(key_id);
+  release(key_id);
+}
+
+/* The DF key of each of layers 0-2 moves on to the next */
+static void test_default_cycle(void) {
+  reset();
+  tap(K_DF);
+  check("DF(1), default", layer_default, 1);
+  check("DF(1), layer 1 key", layer_code(K_LAYER1_Z), KEY_Z);
+  tap(K_DF);
+  check("DF(2), default", layer_default, 2);
+  check("DF(2), layer 2 key", layer_code(K_LAYER2_SPACE), KEY_SPACE);
+  tap(K_DF);
+  check("DF(0), default", layer_default, 0);
+  check("DF(0), layer 0 key", layer_code(K_LAYER1_Z), NA);
+  check("DF cycle, no reports", host_report_count, 0);
+}
+
+/* TRNS shows the next layer down that is on, skipping the ones off */
+static void test_transparent(void) {
+  reset();
+  press(K_MO3);
+  check("TRNS over layer 0", layer_code(K_DF), DF(1));
+  check("TRNS on the MO key", layer_code(K_MO3), MO(3));
+  release(K_MO3);
+  layer_default = 1;
+  layer_update();
+  press(K_MO3);
+  check("TRNS over default layer 1", layer_code(K_DF), DF(2));
+  release(K_MO3);
+  layer_init();
+}
+
+/* OSL(3) lasts until the first key pressed after it goes up, even if
+   another went down in the meantime */
+static void test_oneshot(void) {
+  reset();
+  bind(0, K_SPARE, OSL(3));
+  tap(K_SPARE);
+  check("OSL(3), layer 3 on", layer_active, 1<<3);
+  press(K_LAYER3_AT);
+  check("OSL(3), next key from layer 3", has(KEY_2), 1);
+  press(K_LAYER3_HASH);
+  check("OSL(3), still on for a second key", has(KEY_3), 1);
+  check("OSL(3), still on", layer_active, 1<<3);
+  release(K_LAYER3_AT);
+  check("OSL(3), off with the first key", layer_active, 0);
+  check("OSL(3), second key still down", has(KEY_3), 1);
+  release(K_LAYER3_HASH);
+  check("OSL(3), all up", all_up(), 1);
+  press(K_LAYER3_AT);
+  check("OSL(3) over, layer 0 key", has(KEY_S), 1);
+  release(K_LAYER3_AT);
+  unbind();
+}
+
+/* An open reading shorter than DEBOUNCE_TICKS is chatter and sends
+   nothing.  A real release goes out DEBOUNCE_TICKS scans after the first
+   open one. */
+static void test_debounce(void) {
+  uint8_t i;
+
+  reset();
+  press(K_LAYER0_A);
+  host_matrix[K_LAYER0_A] = false;
+  for(i=0; i<DEBOUNCE_TICKS-1; i++) scan();
+  host_matrix[K_LAYER0_A] = true;
+  for(i=0; i<2*DEBOUNCE_TICKS; i++) scan();
+  check("open glitch, no report", host_report_count, 1);
+
+  // the first open scan and DEBOUNCE_TICKS-1 more
+  host_matrix[K_LAYER0_A] = false;
+  for(i=0; i<DEBOUNCE_TICKS; i++) scan();
+  check("release, not before DEBOUNCE_TICKS", host_report_count, 1);
+  scan();
+  check("release, DEBOUNCE_TICKS after the first open scan", host_report_count, 2);
+  check("release, all up", all_up(), 1);
+}
+
+/* A tap that closes and opens again between two passes of the main loop
+   is still in the snapshot the samples ORed together */
+static void test_short_tap(void) {
+  reset();
+  host_matrix[K_LAYER0_A] = true;
+  matrix_sample();
+  host_matrix[K_LAYER0_A] = false;
+  matrix_sample();
+  matrix_task();
+  check("tap between passes, pressed", has(KEY_A), 1);
+  release(K_LAYER0_A);
+  check("tap between passes, released", all_up(), 1);
+  check("tap between passes, two reports", host_report_count, 2);
+}
+
+// the next USB frame of the main loop, the reports it sent
+static unsigned long frame(void) {
+  unsigned long count = host_report_count;
+  host_frame++;
+  macro_task();
+  return host_report_count - count;
+}
+
+/* Macro 0 of keymap.txt: control held over a tap of A and one of C, one
+   report a frame, none while another report waits to go out, and a tap
+   released on the frame after it */
+static void test_flash_macro(void) {
+  reset();
+  bind(0, K_SPARE, MACRO(0));
+  tap(K_SPARE);
+  check("MACRO(0) key, no report", host_report_count, 0);
+  macro_task();
+  check("MACRO(0), nothing in the same frame", host_report_count, 0);
+  check("MACRO(0), control down", frame(), 1);
+  check("MACRO(0), control", mods(), KEY_CTRL);
+  keyboard_down(KEY_B);
+  check("MACRO(0), held back by a report not yet sent", frame(), 0);
+  send();
+  keyboard_up(KEY_B);
+  send();
+  check("MACRO(0), A tapped", frame(), 1);
+  check("MACRO(0), control A", has(KEY_A) && mods() == KEY_CTRL, 1);
+  check("MACRO(0), A released", frame(), 1);
+  check("MACRO(0), A up", has(KEY_A), 0);
+  check("MACRO(0), C tapped", frame(), 1);
+  check("MACRO(0), control C", has(KEY_C) && mods() == KEY_CTRL, 1);
+  check("MACRO(0), C released", frame(), 1);
+  check("MACRO(0), control up", frame(), 1);
+  check("MACRO(0), all up", all_up(), 1);
+  check("MACRO(0), end", frame(), 0);
+  check("MACRO(0), over", frame(), 0);
+  unbind();
+}
+
+/* EEPROM macro 0 types "Hi", waits 3 frames and types a newline; macro 1
+   holds alt over a tab and waits long enough to be stopped */
+static void test_eeprom_macro(void) {
+  static const uint8_t steps[] = { 'H', 'i', MACRO_WAIT, 3, '\n', MACRO_END,
+                                   MACRO_DOWN, KEY_LEFTALT, MACRO_TAP, KEY_TAB,
+                                   MACRO_WAIT, 200, MACRO_END };
+  unsigned long reports;
+  uint8_t i;
+
+  reset();
+  macro_store(0, steps, sizeof(steps));
+  bind(0, K_SPARE, EMACRO(0));
+  bind(0, K_SPARE2, EMACRO(1));
+  tap(K_SPARE);
+  check("EMACRO(0), H", frame(), 1);
+  check("EMACRO(0), H shifted", has(KEY_H) && mods() == KEY_SHIFT, 1);
+  check("EMACRO(0), H released", frame(), 1);
+  check("EMACRO(0), H up", all_up(), 1);
+  frame();
+  check("EMACRO(0), i not shifted", has(KEY_I) && !mods(), 1);
+  frame();
+  for(reports=0, i=0; i<3; i++) reports += frame();
+  check("EMACRO(0), 3 frames of MACRO_WAIT", reports, 0);
+  check("EMACRO(0), newline after the wait", frame(), 1);
+  check("EMACRO(0), enter", has(KEY_ENTER), 1);
+  frame();
+  check("EMACRO(0), end", frame(), 0);
+
+  // stopped by a second press part way through the wait; the alt the
+  // macro held goes up, the one held on the keyboard stays
+  host_report_count = 0;
+  tap(K_SPARE2);
+  frame();
+  check("EMACRO(1), alt held", mods(), KEY_ALT);
+  frame();
+  check("EMACRO(1), alt tab", has(KEY_TAB), 1);
+  frame();
+  frame();
+  frame();
+  check("EMACRO(1), waiting", host_report_count, 3);
+  press(K_LAYER0_ALT);
+  tap(K_SPARE2);
+  check("EMACRO(1) stopped, real alt still down", mods(), KEY_ALT);
+  release(K_LAYER0_ALT);
+  check("EMACRO(1) stopped, alt up with the key", all_up(), 1);
+  tap(K_SPARE2);
+  tap(K_SPARE2);
+  check("EMACRO(1) stopped before a step, nothing down", mods(), 0);
+  check("EMACRO(1) stopped, no more steps", frame(), 0);
+
+  // and played to its end, which lets go of what it held
+  host_report_count = 0;
+  tap(K_SPARE2);
+  for(i=0; i<210; i++) frame();
+  check("EMACRO(1) played out, reports", host_report_count, 4);
+  check("EMACRO(1) played out, all up", all_up(), 1);
+  unbind();
+}
+
+int main(void) {
+  test_press_release();
+  test_doubled_keys();
+  test_rollover();
+  test_no_repeat();
+  test_layer_released_first();
+  test_default_cycle();
+  test_transparent();
+  test_oneshot();
+  test_debounce();
+  test_short_tap();
+  test_flash_macro();
+  test_eeprom_macro();
+
+  if(failures) return 1;
+  printf("keyboard: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Mock remap interface, so tools/remap.py can be tried without a keyboard.
+//
+// usage: remapdev [-e file]
+//   -e   load the EEPROM from file at start and write it back after every
+//        command, so overlays survive a restart like on the keyboard
+//
+// Reads one request a line on stdin and answers on stdout:
+//   S hex   set the feature report, REMAP_REPORT_SIZE bytes in hex
+//   G       get the feature report, answered with its bytes in hex
+//   K key_id
+//           the code a press of key_id reads now, from the resolved layer
+//           table, answered in hex
+// After each request the main loop runs until the EEPROM is idle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+#include "../keyboard.h"
+#include "../layer.h"
+#include "../remap.h"
+#include "../macro.h"
+
+static const char *eeprom_file = NULL;
+
+static void eeprom_load(void) {
+  FILE *f = fopen(eeprom_file, "rb");
+  if(!f) return;                          // first run, blank EEPROM
+  if(fread(host_eeprom, 1, HAL_EEPROM_SIZE, f) != HAL_EEPROM_SIZE)
+    memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  fclose(f);
+}
+
+static void eeprom_save(void) {
+  FILE *f = fopen(eeprom_file, "wb");
+  if(!f) {
+    perror(eeprom_file);
+    exit(1);
+  }
+  fwrite(host_eeprom, 1, HAL_EEPROM_SIZE, f);
+  fclose(f);
+}
+
+// the main loop until a pass writes nothing, that is every save is done
+static void run_main_loop(void) {
+  unsigned long writes;
+  do {
+    writes = host_eeprom_writes;
+    remap_task();
+    macro_task();
+  } while(host_eeprom_writes != writes);
+  if(eeprom_file) eeprom_save();
+}
+
+static void put_hex(const uint8_t *data, uint8_t len) {
+  for(uint8_t i=0; i<len; i++) printf("%02x", data[i]);
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  char line[256];
+  uint8_t report[REMAP_REPORT_SIZE];
+  unsigned int key_id, byte;
+  int opt;
+
+  while((opt = getopt(argc, argv, "e:")) != -1) {
+    switch(opt) {
+      case 'e':
+        eeprom_file = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-e file]\n", argv[0]);
+        return 2;
+    }
+  }
+  if(eeprom_file) eeprom_load();
+
+  hal_init();
+  remap_load();
+  macro_load();
+  layer_init();
+  keyboard_init();
+
+  while(fgets(line, sizeof(line), stdin)) {
+    switch(line[0]) {
+      case 'S':
+        memset(report, 0, sizeof(report));
+        for(uint8_t i=0; i<REMAP_REPORT_SIZE; i++) {
+          if(sscanf(line + 2 + 2*i, "%2x", &byte) != 1) break;
+          report[i] = byte;
+        }
+        remap_request(report);
+        run_main_loop();
+        printf("ok\n");
+        break;
+      case 'G':
+        remap_reply(report);
+        put_hex(report, REMAP_REPORT_SIZE);
+        break;
+      case 'K':
+        if(sscanf(line + 1, "%u", &key_id) != 1 || key_id >= NKEY) {
+          printf("error\n");
+          break;
+        }
+        printf("%04x\n", layer_keys[key_id]);
+        break;
+      default:
+        printf("error\n");
+        break;
+    }
+    fflush(stdout);
+  }
+  return 0;
+}
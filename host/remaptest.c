@@ -0,0 +1,266 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Checks of the remap commands in remap.c, sent through remap_request()
+// and answered through remap_reply() as the USB interrupt does, with the
+// main loop run until the reply arrives.  A reboot is remap_load() from
+// whatever host_eeprom holds by then.
+//
+// usage: remaptest
+//   exits non-zero and says which check failed if any does
+//
+// The Makefile also builds it as remaptest2 with REMAP_SLOTS 2, for the
+// checks of running out of slots.
+
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "../remap.h"
+#include "../layer.h"
+
+static int failures = 0;
+static uint8_t tag = 0;
+static uint8_t reply[REMAP_REPORT_SIZE];
+
+static void check(const char *what, unsigned long got, unsigned long want) {
+  if(got == want) return;
+  printf("FAIL %s: %lu, expected %lu\n", what, got, want);
+  failures++;
+}
+
+// run the main loop until a pass writes nothing, every save is done
+static void flush(void) {
+  unsigned long writes;
+  do {
+    writes = host_eeprom_writes;
+    remap_task();
+  } while(host_eeprom_writes != writes);
+}
+
+// send a command with n argument bytes, the status of its reply
+static uint8_t command(uint8_t cmd, const uint8_t *args, uint8_t n) {
+  uint8_t report[REMAP_REPORT_SIZE] = { cmd, ++tag };
+  unsigned int i;
+
+  memcpy(report + 2, args, n);
+  remap_request(report);
+  for(i=0; i<10000; i++) {
+    remap_task();
+    remap_reply(reply);
+    if(reply[0] == cmd && reply[1] == tag) return reply[2];
+  }
+  printf("FAIL command %u: no reply\n", cmd);
+  failures++;
+  return 0xFF;
+}
+
+static uint8_t set(uint8_t layer, uint8_t key_id, Keycode code) {
+  uint8_t args[4] = { layer, key_id, code, code >> 8 };
+  return command(REMAP_CMD_SET, args, 4);
+}
+
+static Keycode get(uint8_t layer, uint8_t key_id) {
+  uint8_t args[2] = { layer, key_id };
+  command(REMAP_CMD_GET, args, 2);
+  return reply[3] | reply[4] << 8;
+}
+
+static uint8_t reset_layer(uint8_t layer) {
+  return command(REMAP_CMD_RESET, &layer, 1);
+}
+
+static uint8_t begin(uint8_t layer) {
+  return command(REMAP_CMD_BEGIN, &layer, 1);
+}
+
+// WRITE count codes from key_id on
+static uint8_t write_codes(uint8_t key_id, uint8_t count, const Keycode *codes) {
+  uint8_t args[2 + 2*REMAP_CODES] = { key_id, count };
+  for(uint8_t i=0; i<count; i++) {
+    args[2+2*i] = codes[i];
+    args[3+2*i] = codes[i] >> 8;
+  }
+  return command(REMAP_CMD_WRITE, args, 2 + 2*count);
+}
+
+// BEGIN and WRITE the codes of keys 0 to n-1 as remap.py load does,
+// REMAP_OK if every command was
+static uint8_t upload(uint8_t layer, const Keycode *codes, uint8_t n) {
+  uint8_t status = begin(layer), key_id, count;
+  for(key_id=0; key_id<n && status == REMAP_OK; key_id+=count) {
+    count = n - key_id < REMAP_CODES ? n - key_id : REMAP_CODES;
+    status = write_codes(key_id, count, codes + key_id);
+  }
+  return status;
+}
+
+static uint8_t commit(void) {
+  return command(REMAP_CMD_COMMIT, NULL, 0);
+}
+
+static void reboot(void) {
+  flush();
+  remap_load();
+  layer_init();
+}
+
+// true if every key of layer reads as codes[]
+static unsigned long layer_is(uint8_t layer, const Keycode *codes) {
+  for(uint8_t key_id=0; key_id<NKEY; key_id++)
+    if(remap_code(layer, key_id) != codes[key_id]) return 0;
+  return 1;
+}
+
+static unsigned long layer_is_flash(uint8_t layer) {
+  for(uint8_t key_id=0; key_id<NKEY; key_id++)
+    if(remap_code(layer, key_id) != keymap_code(layer, key_id)) return 0;
+  return 1;
+}
+
+// put code on key_id of every saved copy of layer, with a good CRC
+static void plant(uint8_t layer, uint8_t key_id, Keycode code) {
+  uint8_t copy, *p;
+  uint16_t crc, i;
+  for(copy=0; copy<2; copy++) {
+    p = host_eeprom + REMAP_START + (layer*2 + copy) * REMAP_COPY_SIZE;
+    if(p[0] != REMAP_VERSION) continue;
+    p[4 + 2*key_id] = code;
+    p[5 + 2*key_id] = code >> 8;
+    for(crc=0xFFFF, i=0; i<REMAP_COPY_SIZE-2; i++) crc = crc16_update(crc, p[i]);
+    p[i] = crc;
+    p[i+1] = crc >> 8;
+  }
+}
+
+/* Codes with no report bit or no action behind them are turned away, by
+   SET, by WRITE and in an EEPROM copy */
+static void test_bad_codes(void) {
+  static const Keycode bad[] = { USAGE_MAX + 1, 0xFF, MO(MODES), DF(0xFF),
+                                 ACTION(ACTION_LED, 6), ACTION(ACTION_MACRO + 1, 0) };
+  Keycode codes[2] = { KEY_A, 0xE8 };
+  uint8_t i;
+
+  reboot();
+  for(i=0; i<sizeof(bad)/sizeof(bad[0]); i++)
+    check("SET of a bad code", set(0, 5, bad[i]), REMAP_BAD_ARGUMENT);
+  check("bad codes, layer left alone", layer_is_flash(0), 1);
+  check("SET of a modifier usage", set(0, 5, USAGE_MAX), REMAP_OK);
+  check("SET of an EEPROM macro", set(0, 5, EMACRO(3)), REMAP_OK);
+
+  check("BEGIN", begin(1), REMAP_OK);
+  check("WRITE with a bad code", write_codes(0, 2, codes), REMAP_BAD_ARGUMENT);
+  check("WRITE again where the bad one was", write_codes(0, 1, codes), REMAP_OK);
+
+  reset_layer(0xFF);
+  check("SET for the copy", set(2, 7, KEY_B), REMAP_OK);
+  flush();
+  plant(2, 7, 0xE8);
+  reboot();
+  check("copy with a bad code, not loaded", remap_layers, 0);
+  check("copy with a bad code, flash layer", layer_is_flash(2), 1);
+}
+
+/* A whole layer goes up, is switched to at COMMIT and is there again
+   after a reboot */
+static void test_upload(void) {
+  Keycode codes[NKEY];
+  uint8_t i;
+
+  for(i=0; i<NKEY; i++) codes[i] = KEY_A + i % 26;
+  reset_layer(0xFF);
+  reboot();
+  check("upload", upload(1, codes, NKEY), REMAP_OK);
+  check("upload, not yet switched to", layer_is_flash(1), 1);
+  check("COMMIT", commit(), REMAP_OK);
+  check("COMMIT, switched to", layer_is(1, codes), 1);
+  check("COMMIT, overlaid", remap_layers, 1<<1);
+  check("COMMIT, GET", get(1, 30), codes[30]);
+  reboot();
+  check("reboot, uploaded layer", layer_is(1, codes), 1);
+
+  // and once more over the overlay, which now has a copy of its own
+  for(i=0; i<NKEY; i++) codes[i] = KEY_Z - i % 26;
+  upload(1, codes, NKEY);
+  check("second COMMIT", commit(), REMAP_OK);
+  reboot();
+  check("reboot, second upload", layer_is(1, codes), 1);
+}
+
+/* An upload never committed leaves the layer as it was, however far it
+   got before the power went */
+static void test_interrupted(void) {
+  Keycode old[NKEY], codes[NKEY];
+  uint8_t i;
+
+  for(i=0; i<NKEY; i++) {
+    old[i] = remap_code(1, i);
+    codes[i] = KEY_1 + i % 10;
+  }
+  check("half an upload", upload(1, codes, NKEY/2), REMAP_OK);
+  reboot();
+  check("half an upload, old layer", layer_is(1, old), 1);
+  check("whole upload, no COMMIT", upload(1, codes, NKEY), REMAP_OK);
+  reboot();
+  check("whole upload, no COMMIT, old layer", layer_is(1, old), 1);
+  check("upload after an interrupted one", upload(1, codes, NKEY), REMAP_OK);
+  check("COMMIT after an interrupted one", commit(), REMAP_OK);
+  reboot();
+  check("reboot, after an interrupted one", layer_is(1, codes), 1);
+}
+
+/* WRITEs come in order after a BEGIN and COMMIT needs every key; a SET
+   of the layer drops the upload, its save takes the same copy */
+static void test_upload_order(void) {
+  Keycode codes[REMAP_CODES] = { KEY_A };
+
+  reboot();
+  check("COMMIT without BEGIN", commit(), REMAP_NO_UPLOAD);
+  check("WRITE without BEGIN", write_codes(0, 1, codes), REMAP_NO_UPLOAD);
+  begin(3);
+  check("WRITE out of order", write_codes(REMAP_CODES, 1, codes), REMAP_BAD_ARGUMENT);
+  write_codes(0, 1, codes);
+  check("COMMIT short of NKEY", commit(), REMAP_BAD_ARGUMENT);
+  set(3, 0, KEY_B);
+  check("WRITE after a SET of the layer", write_codes(1, 1, codes), REMAP_NO_UPLOAD);
+  check("COMMIT after a SET of the layer", commit(), REMAP_NO_UPLOAD);
+  reset_layer(0xFF);
+}
+
+/* Every slot taken: a layer that is not overlaid can not be, until a
+   RESET frees one */
+static void test_slots(void) {
+  uint8_t layer, full = 0;
+
+  reset_layer(0xFF);
+  reboot();
+  for(layer=0; layer<REMAP_SLOTS; layer++) {
+    check("SET while slots are free", set(layer, 0, KEY_A), REMAP_OK);
+    full |= 1<<layer;
+  }
+  check("slots in use", remap_layers, full);
+#if REMAP_SLOTS < MODES
+  layer = REMAP_SLOTS;
+  check("SET with every slot taken", set(layer, 0, KEY_A), REMAP_NO_ROOM);
+  check("BEGIN with every slot taken", begin(layer), REMAP_NO_ROOM);
+  check("SET of an overlaid layer", set(0, 1, KEY_B), REMAP_OK);
+  reset_layer(0);
+  check("SET after a RESET", set(layer, 0, KEY_A), REMAP_OK);
+  reboot();
+  check("reboot, the slot moved", remap_layers, (full & ~1) | 1<<layer);
+#endif
+  reset_layer(0xFF);
+  reboot();
+  check("RESET of every layer", remap_layers, 0);
+}
+
+int main(void) {
+  hal_init();
+  test_bad_codes();
+  test_upload();
+  test_interrupted();
+  test_upload_order();
+  test_slots();
+
+  if(failures) return 1;
+  printf("remap (%u slots): all checks passed\n", REMAP_SLOTS);
+  return 0;
+}
@@ -0,0 +1,172 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Checks of the settings journal in settings.c, on host_eeprom.  Saves
+// are let out by stepping host_timer_skew past SETTINGS_DELAY_MS.
+//
+// usage: settingstest
+//   exits non-zero and says which check failed if any does
+
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "../settings.h"
+#include "../layer.h"
+#include "../led.h"
+
+#define RECORD_SIZE     (3 + sizeof(Settings) + 2)      // as in settings.c
+
+static int failures = 0;
+static LedLayer defaults[MODES];
+
+static void check(const char *what, unsigned long got, unsigned long want) {
+  if(got == want) return;
+  printf("FAIL %s: %lu, expected %lu\n", what, got, want);
+  failures++;
+}
+
+static uint8_t *slot_bytes(uint8_t slot) {
+  return host_eeprom + SETTINGS_START + slot * SETTINGS_SLOT;
+}
+
+static uint16_t slot_seq(uint8_t slot) {
+  return slot_bytes(slot)[1] | slot_bytes(slot)[2] << 8;
+}
+
+// a record as settings.c writes it, with default_layer and the defaults
+static void put_record(uint8_t slot, uint16_t seq, uint8_t default_layer) {
+  uint8_t *p = slot_bytes(slot);
+  Settings s;
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  s.layer_default = default_layer;
+  for(i=0; i<MODES; i++) {
+    s.led_color[i] = defaults[i].color;
+    s.led_color2[i] = defaults[i].color2;
+  }
+  p[0] = SETTINGS_VERSION;
+  p[1] = seq;
+  p[2] = seq >> 8;
+  memcpy(p + 3, &s, sizeof(s));
+  for(i=0; i<RECORD_SIZE-2; i++) crc = crc16_update(crc, p[i]);
+  p[i] = crc;
+  p[i+1] = crc >> 8;
+}
+
+// start from the defaults and load what the EEPROM holds
+static void boot(void) {
+  memcpy(led_layers, defaults, sizeof(defaults));
+  layer_init();
+  settings_load();
+}
+
+// make default_layer the default and wait until its record is written
+static void save(uint8_t default_layer) {
+  unsigned long writes = host_eeprom_writes, i;
+
+  layer_default = default_layer;
+  settings_changed();
+  for(i=0; i<100000 && host_eeprom_writes - writes < RECORD_SIZE; i++) {
+    host_timer_skew += 0x4000;
+    settings_task();
+  }
+}
+
+static unsigned long leds_default(void) {
+  return !memcmp(led_layers, defaults, sizeof(defaults));
+}
+
+/* Nothing that checks out: the defaults stay */
+static void test_empty(void) {
+  uint8_t slot;
+
+  memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  boot();
+  check("zeroed EEPROM, default layer", layer_default, 0);
+  check("zeroed EEPROM, LED colours", leds_default(), 1);
+
+  memset(host_eeprom, 0xFF, HAL_EEPROM_SIZE);
+  boot();
+  check("erased EEPROM, default layer", layer_default, 0);
+  check("erased EEPROM, LED colours", leds_default(), 1);
+
+  memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  for(slot=0; slot<SETTINGS_SLOTS; slot++) {
+    put_record(slot, slot + 1, 2);
+    slot_bytes(slot)[RECORD_SIZE-1] ^= 0x5A;
+  }
+  boot();
+  check("every CRC bad, default layer", layer_default, 0);
+  check("every CRC bad, LED colours", leds_default(), 1);
+}
+
+/* A power loss part way through the newest record leaves the one
+   before it */
+static void test_torn(void) {
+  memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  put_record(20, 5, 1);
+  put_record(21, 6, 2);
+  boot();
+  check("whole records, the newest", layer_default, 2);
+  memset(slot_bytes(21) + RECORD_SIZE/2, 0, RECORD_SIZE - RECORD_SIZE/2);
+  boot();
+  check("torn newest record, the one before", layer_default, 1);
+  save(3);
+  check("save after a torn record, over it", slot_seq(21), 6);
+  boot();
+  check("save after a torn record, loaded", layer_default, 3);
+}
+
+/* 0xFFFF is followed by 0 and 0 is still the newer */
+static void test_wrap(void) {
+  memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  put_record(10, 0xFFFE, 1);
+  boot();
+  check("before the wrap, loaded", layer_default, 1);
+  save(2);
+  save(3);
+  check("after the wrap, 0xFFFF written", slot_seq(11), 0xFFFF);
+  check("after the wrap, 0 written", slot_seq(12), 0);
+  boot();
+  check("after the wrap, newest loaded", layer_default, 3);
+}
+
+/* Saves go round every slot in turn: twice round, the slot after the
+   first one written holds the record of the second turn, and so on */
+static void test_wear(void) {
+  unsigned long writes;
+  uint8_t first, slot;
+  uint16_t seq;
+  unsigned int n;
+
+  memset(host_eeprom, 0, HAL_EEPROM_SIZE);
+  boot();
+  writes = host_eeprom_writes;
+  save(0);
+  for(first=0; first<SETTINGS_SLOTS-1 && !slot_bytes(first)[0]; first++);
+  seq = slot_seq(first);
+  for(n=1; n<2*SETTINGS_SLOTS; n++) save(n % MODES);
+  check("two turns, bytes written", host_eeprom_writes - writes,
+        2 * SETTINGS_SLOTS * RECORD_SIZE);
+  for(n=0; n<SETTINGS_SLOTS; n++) {
+    slot = (first + n) % SETTINGS_SLOTS;
+    check("two turns, each slot written in turn", slot_seq(slot),
+          (uint16_t)(seq + SETTINGS_SLOTS + n));
+  }
+  boot();
+  check("two turns, last save loaded", layer_default, (2*SETTINGS_SLOTS - 1) % MODES);
+}
+
+int main(void) {
+  hal_init();
+  memcpy(defaults, led_layers, sizeof(defaults));
+
+  test_empty();
+  test_torn();
+  test_wrap();
+  test_wear();
+
+  if(failures) return 1;
+  printf("settings: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,51 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Checks of the timing histograms in stats.c.
+//
+// usage: statstest
+//   exits non-zero and says which check failed if any does
+
+#include <stdio.h>
+#include "host.h"
+#include "../stats.h"
+
+static int failures = 0;
+
+static void check(const char *what, unsigned long got, unsigned long want) {
+  if(got == want) return;
+  printf("FAIL %s: %lu, expected %lu\n", what, got, want);
+  failures++;
+}
+
+static uint16_t field(const uint8_t *report, uint8_t hist, uint8_t n) {
+  const uint8_t *p = report + 2 + hist*10 + n*2;
+  return p[0] | p[1] << 8;
+}
+
+int main(void) {
+  uint8_t report[STATS_REPORT_SIZE];
+  unsigned long i;
+
+  // more samples than the 16 bit count holds, split over two buckets, so
+  // the decay must be driven by the count and not by a single bucket
+  stats_reset();
+  for(i=0; i<70000; i++) stats_record(STATS_SCAN, i & 1 ? 40 : 10);
+  stats_report(report);
+  check("count kept below 65536 and above half of it",
+        field(report, STATS_SCAN, 0) >= 0x8000, 1);
+  check("min", field(report, STATS_SCAN, 1), 10);
+  check("max", field(report, STATS_SCAN, 2), 40);
+  check("p50, top of the bucket of 10", field(report, STATS_SCAN, 3), 11);
+  check("p99, clamped to max", field(report, STATS_SCAN, 4), 40);
+
+  // mostly fast samples with a slow tail of 2%
+  stats_reset();
+  for(i=0; i<200000; i++) stats_record(STATS_PASS, i % 50 ? 10 : 1000);
+  stats_report(report);
+  check("p50 with a tail", field(report, STATS_PASS, 3), 11);
+  check("p99 with a tail", field(report, STATS_PASS, 4), 1000);
+
+  if(failures) return 1;
+  printf("stats: all checks passed\n");
+  return 0;
+}
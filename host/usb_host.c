@@ -0,0 +1,69 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Host implementation of the usb_keyboard.h API that records reports
+
+#include <stdio.h>
+#include "../usb_keyboard.h"
+#include "host.h"
+#include "../stats.h"
+
+uint8_t keyboard_modifier_keys=0;
+uint8_t keyboard_keys[6]={0,0,0,0,0,0};
+uint8_t keyboard_nkro[NKRO_KEYS_BYTES];
+volatile uint8_t keyboard_leds=0;
+
+uint8_t host_protocol = 1;
+uint8_t host_reports[HOST_REPORT_LOG][HOST_REPORT_SIZE];
+unsigned long host_report_count;
+bool host_trace = false;
+uint8_t host_frame = 0;
+
+void usb_init(void) {
+}
+
+uint8_t usb_configured(void) {
+  return 1;
+}
+
+uint8_t usb_frame(void) {
+  return host_frame;
+}
+
+int8_t usb_keyboard_send(void) {
+  uint8_t i, n, *report = host_reports[host_report_count % HOST_REPORT_LOG];
+
+  if (host_protocol) {
+    for (i=0; i<NKRO_KEYS_BYTES; i++) report[i] = keyboard_nkro[i];
+    report[NKRO_KEYS_BYTES] = keyboard_modifier_keys;
+    n = HOST_REPORT_SIZE;
+  } else {
+    report[0] = keyboard_modifier_keys;
+    report[1] = 0;
+    for (i=0; i<6; i++) report[i+2] = keyboard_keys[i];
+    n = 8;
+  }
+  host_report_count++;
+  // the mock endpoint is always free, a report is armed as it is sent
+  stats_record(STATS_QUEUE, 0);
+  stats_record(STATS_LATENCY, hal_timer_now() - stats_edge);
+  if (host_trace) {
+    for (i=0; i<n; i++) printf("%02x%c", report[i], i<n-1? ' ': '\n');
+  }
+  return 0;
+}
+
+FILE *host_debug = NULL;
+
+// the debug stream goes to host_debug, unpadded, for tools/debuglog.py
+int8_t usb_debug_write(const uint8_t *data, uint8_t len) {
+  if (host_debug) fwrite(data, 1, len, host_debug);
+  return 0;
+}
+
+int8_t usb_debug_putchar(uint8_t c) {
+  return usb_debug_write(&c, 1);
+}
+
+void usb_debug_flush_output(void) {
+  if (host_debug) fflush(host_debug);
+}
@@ -0,0 +1,199 @@
+/* Key handling for the Virulent Keyboard
+ * Adapted from Phantom Keyboard Firmware
+ * Copyright (c) 2013 John Fonte
+ *
+ * Copyright (c) 2012 Fredrik Atmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "usb_keyboard.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "layer.h"
+#include "led.h"
+#include "macro.h"
+
+/* key_codes holds what each key resolved to when it was pressed.  Reports
+   and the release use it, so a key keeps its meaning while held even if
+   the layers change under it, and no modifier or layer is left stuck. */
+static Keycode key_codes[NKEY];
+
+/* How many held keys send each usage and each modifier bit.  A usage goes
+   into the reports when its count leaves zero and comes out when it gets
+   back there, so when two keys send the same code, as the doubled letters
+   of the gaming layouts do, either can be released first.  Every press and
+   release updates the report buffers in place. */
+static uint8_t usage_refs[0xE0];
+static uint8_t mod_refs[8];
+
+/* report_dirty is nonzero once put() has changed a byte of the report
+   buffers since the last send().  Changes can cancel out, a usage set and
+   cleared again before the send, so send() checks the buffers against
+   the sent_ copies of the last report it queued and clears report_dirty
+   without queueing when they are the same. */
+uint8_t report_dirty = 0;
+static uint8_t sent_nkro[NKRO_KEYS_BYTES];
+static uint8_t sent_keys[6];
+static uint8_t sent_mods = 0;
+
+static inline void put(uint8_t *report, uint8_t value) {
+  report_dirty |= *report ^ value;
+  *report = value;
+}
+
+void keyboard_init(void) {
+  uint8_t i;
+  for(i=0; i<0xE0; i++) usage_refs[i] = 0;
+  for(i=0; i<8; i++) mod_refs[i] = 0;
+  for(i=0; i<NKRO_KEYS_BYTES; i++) put(&keyboard_nkro[i], 0);
+  for(i=0; i<6; i++) put(&keyboard_keys[i], 0);
+  put(&keyboard_modifier_keys, 0);
+}
+
+/* The six slot report lists the newest usages first.  With more than six
+   held the oldest fall off the end; when a slot frees up one of them is
+   found in the NKRO bitmap and takes it. */
+static void refill(void) {
+  uint8_t i, usage;
+  for(usage=4; usage<0xE0; usage++) {
+    if(!(keyboard_nkro[usage>>3] & 1<<(usage&7))) continue;
+    for(i=0; i<5 && keyboard_keys[i] != usage; i++);
+    if(i == 5) {
+      put(&keyboard_keys[5], usage);
+      return;
+    }
+  }
+}
+
+static void add_usage(uint8_t usage) {
+  uint8_t i;
+  if(usage_refs[usage]++) return;
+  put(&keyboard_nkro[usage>>3], keyboard_nkro[usage>>3] | 1<<(usage&7));
+  for(i=5; i>0; i--) put(&keyboard_keys[i], keyboard_keys[i-1]);
+  put(&keyboard_keys[0], usage);
+}
+
+static void remove_usage(uint8_t usage) {
+  uint8_t i, full = keyboard_keys[5];
+  if(!usage_refs[usage] || --usage_refs[usage]) return;
+  put(&keyboard_nkro[usage>>3], keyboard_nkro[usage>>3] & ~(1<<(usage&7)));
+  for(i=0; i<6 && keyboard_keys[i] != usage; i++);
+  if(i == 6) return;
+  for(; i<5; i++) put(&keyboard_keys[i], keyboard_keys[i+1]);
+  put(&keyboard_keys[5], 0);
+  if(full) refill();
+}
+
+static void add_mods(uint8_t mods) {
+  for(uint8_t bit=0; mods; bit++, mods>>=1)
+    if((mods & 1) && !mod_refs[bit]++)
+      put(&keyboard_modifier_keys, keyboard_modifier_keys | 1<<bit);
+}
+
+static void remove_mods(uint8_t mods) {
+  for(uint8_t bit=0; mods; bit++, mods>>=1)
+    if((mods & 1) && mod_refs[bit] && !--mod_refs[bit])
+      put(&keyboard_modifier_keys, keyboard_modifier_keys & ~(1<<bit));
+}
+
+/* Called once per scan that changed a key, the reports are already up to
+   date.  Nothing is sent when they came out the same as the last one. */
+void send(void) {
+  uint8_t i;
+
+  if(!report_dirty) return;
+  for(i=0; i<NKRO_KEYS_BYTES && keyboard_nkro[i] == sent_nkro[i]; i++);
+  if(i == NKRO_KEYS_BYTES && keyboard_modifier_keys == sent_mods) {
+    for(i=0; i<6 && keyboard_keys[i] == sent_keys[i]; i++);
+    if(i == 6) {
+      report_dirty = 0;
+      return;
+    }
+  }
+  if(usb_keyboard_send()) return;
+  for(i=0; i<NKRO_KEYS_BYTES; i++) sent_nkro[i] = keyboard_nkro[i];
+  for(i=0; i<6; i++) sent_keys[i] = keyboard_keys[i];
+  sent_mods = keyboard_modifier_keys;
+  report_dirty = 0;
+}
+
+void keyboard_down(Keycode code) {
+  uint8_t usage = KEYCODE_USAGE(code);
+  if(usage > USAGE_MAX) return;         // no bit in the NKRO report
+  if(IS_MODIFIER(usage))
+    add_mods(MODIFIER_BIT(usage));
+  else if(usage)
+    add_usage(usage);
+  add_mods(KEYCODE_MODS(code));
+}
+
+void keyboard_up(Keycode code) {
+  uint8_t usage = KEYCODE_USAGE(code);
+  if(usage > USAGE_MAX) return;         // no bit in the NKRO report
+  if(IS_MODIFIER(usage))
+    remove_mods(MODIFIER_BIT(usage));
+  else if(usage)
+    remove_usage(usage);
+  remove_mods(KEYCODE_MODS(code));
+}
+
+/* Layer, lighting and macro keys act on press (MO also on release) and
+   never reach a report */
+static void action(Keycode code, bool pressed) {
+  if(KEYCODE_ACTION(code) == ACTION_MACRO) {
+    if(pressed) macro_play(KEYCODE_ARG(code));
+    return;
+  }
+  if(KEYCODE_ACTION(code) != ACTION_LED) {
+    layer_action(code, pressed);
+    return;
+  }
+  if(!pressed) return;
+  switch(code) {
+    case LED_HUI: led_adjust_hue(LED_ADJUST_STEP); break;
+    case LED_HUD: led_adjust_hue(-LED_ADJUST_STEP); break;
+    case LED_SAI: led_adjust_saturation(LED_ADJUST_STEP); break;
+    case LED_SAD: led_adjust_saturation(-LED_ADJUST_STEP); break;
+    case LED_VAI: led_adjust_value(LED_ADJUST_STEP); break;
+    case LED_VAD: led_adjust_value(-LED_ADJUST_STEP); break;
+  }
+}
+
+void key_press(uint8_t key_id) {
+  Keycode code = key_codes[key_id] = layer_code(key_id);
+  uint8_t usage = KEYCODE_USAGE(code);
+  if(IS_ACTION(code)) {
+    action(code, true);
+    return;
+  }
+  keyboard_down(code);
+  if(usage && !IS_MODIFIER(usage)) layer_key(key_id, true);
+}
+
+void key_release(uint8_t key_id) {
+  Keycode code = key_codes[key_id];
+  uint8_t usage = KEYCODE_USAGE(code);
+  if(IS_ACTION(code)) {
+    action(code, false);
+    return;
+  }
+  keyboard_up(code);
+  if(usage && !IS_MODIFIER(usage)) layer_key(key_id, false);
+}
@@ -0,0 +1,24 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Key queue and HID report assembly
+
+#ifndef __KEYBOARD__
+#define __KEYBOARD__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+#include "keymap.h"
+
+extern uint8_t report_dirty;
+
+void keyboard_init(void);
+void send(void);
+
+// add or take away one reference to a usage and its modifiers, for keys
+// that are not in the matrix (macros)
+void keyboard_down(Keycode code);
+void keyboard_up(Keycode code);
+void key_press(uint8_t key_id);
+void key_release(uint8_t key_id);
+#endif
@@ -0,0 +1,110 @@
+/* Generated by tools/keymapgen.py from keymap.txt, do not edit. */
+
+#include "usb_keyboard.h"
+#include "keymap.h"
+#include "macro.h"
+
+#if NKEY != 114 || MODES != 4
+#error "keymap.c is out of date, run make keymap"
+#endif
+
+const KeymapLayer PROGMEM keymap_layers[MODES] = {
+  {    0,            0 },  // LAYOUT 0: 50-KEY, 51 codes
+  {   51, KEYMAP_DENSE },  // LAYOUT 1: RTS GAMING, 114 codes
+  {  165, KEYMAP_DENSE },  // LAYOUT 2: NORMAL PEOPLE, 114 codes
+  {  279,            0 },  // LAYOUT 3: FN 50-KEY, 51 codes
+};
+
+const uint8_t PROGMEM keymap_present[][KEYMAP_BYTES] = {
+  { 0x00, 0x00, 0x00, 0x80, 0xF3, 0x38, 0xCF, 0xF3, 0x3C, 0xCF, 0xE3, 0x3C, 0xCF, 0x72, 0x00 }
+};
+
+const uint8_t PROGMEM keymap_rank[][KEYMAP_BYTES] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x01, 0x07, 0x0A, 0x10, 0x16, 0x1A, 0x20, 0x25, 0x29, 0x2F, 0x33 }
+};
+
+const uint8_t PROGMEM keymap_popcount[16] = {
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+const Keycode PROGMEM keymap_codes[330] = {
+  // LAYOUT 0: 50-KEY
+  DF(1),           KEY_ENTER,       KEY_TAB,         // COL  5
+  KEY_LEFTGUI,     MO(3),           KEY_A,           KEY_Q,           // COL  6
+  KEY_Z,           KEY_S,           KEY_W,           // COL  7
+  KEY_LEFTALT,     KEY_X,           KEY_D,           KEY_E,           // COL  8
+  KEY_LEFTSHIFT,   KEY_C,           KEY_F,           KEY_R,           // COL  9
+  KEY_LEFTCONTROL, KEY_V,           KEY_G,           KEY_T,           // COL 10
+  KEY_BACKSPACE,   KEY_B,           KEY_H,           KEY_Y,           // COL 11
+  KEY_SPACE,       KEY_N,           KEY_J,           KEY_U,           // COL 12
+  KEY_DELETE,      KEY_M,           KEY_K,           KEY_I,           // COL 13
+  KEY_COMMA,       KEY_L,           KEY_O,           // COL 14
+  KEY_RIGHTGUI,    KEY_PERIOD,      KEY_SEMICOLON,   KEY_P,           // COL 15
+  KEY_LEFT,        KEY_SLASH,       KEY_QUOTE,       KEY_LEFT_BRACE,  // COL 16
+  KEY_DOWN,        KEY_UP,          KEY_RIGHT_BRACE, // COL 17
+  KEY_RIGHT,       KEY_ESC,         KEY_BACKSLASH,   // COL 18
+  // LAYOUT 1: RTS GAMING
+  NA,              KEY_Z,           KEY_A,           KEY_Q,           KEY_1,           NA,              // COL  0
+  KEY_ESC,         KEY_X,           KEY_S,           KEY_W,           KEY_2,           NA,              // COL  1
+  KEY_DELETE,      KEY_C,           KEY_D,           KEY_E,           KEY_3,           NA,              // COL  2
+  KEY_LEFTSHIFT,   KEY_V,           KEY_F,           KEY_R,           KEY_4,           NA,              // COL  3
+  KEY_LEFTCONTROL, KEY_B,           KEY_G,           KEY_T,           KEY_5,           NA,              // COL  4
+  KEY_LEFTCONTROL, DF(2),           KEY_LEFTSHIFT,   KEY_TAB,         KEY_TILDE,       KEY_ESC,         // COL  5
+  KEY_LEFTGUI,     KEY_LEFTSHIFT,   KEY_A,           KEY_Q,           KEY_1,           NA,              // COL  6
+  NA,              KEY_Z,           KEY_S,           KEY_W,           KEY_2,           KEY_F1,          // COL  7
+  KEY_LEFTALT,     KEY_X,           KEY_D,           KEY_E,           KEY_3,           KEY_F2,          // COL  8
+  KEY_LEFTSHIFT,   KEY_C,           KEY_F,           KEY_R,           KEY_4,           KEY_F3,          // COL  9
+  KEY_LEFTCONTROL, KEY_V,           KEY_G,           KEY_T,           KEY_5,           KEY_F4,          // COL 10
+  KEY_BACKSPACE,   KEY_B,           KEY_H,           KEY_Y,           KEY_6,           KEY_F5,          // COL 11
+  KEY_SPACE,       KEY_N,           KEY_J,           KEY_U,           KEY_7,           KEY_F6,          // COL 12
+  KEY_DELETE,      KEY_M,           KEY_K,           KEY_I,           KEY_8,           KEY_F7,          // COL 13
+  NA,              KEY_COMMA,       KEY_L,           KEY_O,           KEY_9,           KEY_F8,          // COL 14
+  KEY_RIGHTGUI,    KEY_PERIOD,      KEY_SEMICOLON,   KEY_P,           KEY_0,           KEY_F9,          // COL 15
+  KEY_LEFT,        KEY_SLASH,       KEY_QUOTE,       KEY_LEFT_BRACE,  KEY_MINUS,       KEY_F10,         // COL 16
+  KEY_DOWN,        KEY_UP,          NA,              KEY_RIGHT_BRACE, KEY_EQUAL,       KEY_F11,         // COL 17
+  KEY_RIGHT,       KEY_RIGHTSHIFT,  KEY_ENTER,       KEY_BACKSLASH,   KEY_BACKSPACE,   KEY_F12,         // COL 18
+  // LAYOUT 2: NORMAL PEOPLE
+  KEY_LEFTCONTROL, KEY_Z,           KEY_A,           KEY_Q,           KEY_1,           NA,              // COL  0
+  KEY_LEFTGUI,     KEY_X,           KEY_S,           KEY_W,           KEY_2,           NA,              // COL  1
+  KEY_LEFTALT,     KEY_C,           KEY_D,           KEY_E,           KEY_3,           NA,              // COL  2
+  KEY_LEFTSHIFT,   KEY_V,           KEY_F,           KEY_R,           KEY_4,           NA,              // COL  3
+  KEY_LEFTCONTROL, KEY_B,           KEY_G,           KEY_T,           KEY_5,           NA,              // COL  4
+  KEY_LEFTCONTROL, DF(0),           KEY_LEFTSHIFT,   KEY_TAB,         KEY_TILDE,       KEY_ESC,         // COL  5
+  KEY_LEFTGUI,     KEY_LEFTSHIFT,   KEY_A,           KEY_Q,           KEY_1,           NA,              // COL  6
+  NA,              KEY_Z,           KEY_S,           KEY_W,           KEY_2,           KEY_F1,          // COL  7
+  KEY_LEFTALT,     KEY_X,           KEY_D,           KEY_E,           KEY_3,           KEY_F2,          // COL  8
+  KEY_SPACE,       KEY_C,           KEY_F,           KEY_R,           KEY_4,           KEY_F3,          // COL  9
+  KEY_SPACE,       KEY_V,           KEY_G,           KEY_T,           KEY_5,           KEY_F4,          // COL 10
+  KEY_SPACE,       KEY_B,           KEY_H,           KEY_Y,           KEY_6,           KEY_F5,          // COL 11
+  KEY_SPACE,       KEY_N,           KEY_J,           KEY_U,           KEY_7,           KEY_F6,          // COL 12
+  KEY_DELETE,      KEY_M,           KEY_K,           KEY_I,           KEY_8,           KEY_F7,          // COL 13
+  NA,              KEY_COMMA,       KEY_L,           KEY_O,           KEY_9,           KEY_F8,          // COL 14
+  KEY_RIGHTALT,    KEY_PERIOD,      KEY_SEMICOLON,   KEY_P,           KEY_0,           KEY_F9,          // COL 15
+  KEY_LEFT,        KEY_SLASH,       KEY_QUOTE,       KEY_LEFT_BRACE,  KEY_MINUS,       KEY_F10,         // COL 16
+  KEY_DOWN,        KEY_UP,          NA,              KEY_RIGHT_BRACE, KEY_EQUAL,       KEY_F11,         // COL 17
+  KEY_RIGHT,       KEY_RIGHTSHIFT,  KEY_ENTER,       KEY_BACKSLASH,   KEY_BACKSPACE,   KEY_F12,         // COL 18
+  // LAYOUT 3: FN 50-KEY
+  TRNS,            S(KEY_TILDE),    KEY_TILDE,       // COL  5
+  KEY_LEFTGUI,     TRNS,            S(KEY_1),        KEY_1,           // COL  6
+  KEY_F1,          S(KEY_2),        KEY_2,           // COL  7
+  KEY_LEFTALT,     KEY_F2,          S(KEY_3),        KEY_3,           // COL  8
+  KEY_LEFTSHIFT,   KEY_F3,          S(KEY_4),        KEY_4,           // COL  9
+  KEY_LEFTCONTROL, KEY_F4,          S(KEY_5),        KEY_5,           // COL 10
+  KEY_BACKSPACE,   KEY_F5,          S(KEY_6),        KEY_6,           // COL 11
+  KEY_SPACE,       KEY_F6,          S(KEY_7),        KEY_7,           // COL 12
+  KEY_DELETE,      KEY_F7,          S(KEY_8),        KEY_8,           // COL 13
+  KEY_F8,          S(KEY_9),        KEY_9,           // COL 14
+  KEY_RIGHTGUI,    KEY_F9,          S(KEY_0),        KEY_0,           // COL 15
+  KEY_PAGE_UP,     KEY_F10,         S(KEY_MINUS),    KEY_MINUS,       // COL 16
+  KEY_PAGE_DOWN,   KEY_F11,         KEY_EQUAL,       // COL 17
+  KEY_END,         KEY_F12,         S(KEY_EQUAL),    // COL 18
+};
+
+const uint8_t PROGMEM macro_steps[] = {
+  // macro 0
+  MACRO_DOWN, KEY_LEFTCONTROL, MACRO_TAP, KEY_A, MACRO_TAP, KEY_C, MACRO_UP, KEY_LEFTCONTROL,
+  MACRO_END,
+};
+
+const uint16_t PROGMEM macro_index[] = { 0 };
+const uint8_t macro_count = 1;
@@ -0,0 +1,93 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Key layouts, looked up by layer and key_id = col*NROW+row.
+// keymap.c is generated from keymap.txt by tools/keymapgen.py.
+
+#ifndef __KEYMAP__
+#define __KEYMAP__
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "config.h"
+
+/* Keycodes are 16 bits.  Below 0x1000 the low byte is a HID usage and
+   bits 8-11 add left modifiers (KEY_CTRL..KEY_GUI) to it, so S(KEY_1) is
+   a '!'.  From 0x1000 up the high byte is an action and the low byte its
+   argument: a layer, which lighting control, or a macro. */
+typedef uint16_t Keycode;
+
+#define TRNS                1       // transparent, use the next active layer down
+#define MODS(mods, code)    ((Keycode)((mods) << 8 | (code)))
+#define S(code)             MODS(KEY_SHIFT, code)
+
+#define ACTION_MO           0x10    // layer on while held
+#define ACTION_TG           0x11    // layer toggled on each press
+#define ACTION_OSL          0x12    // layer on for the next key
+#define ACTION_DF           0x13    // layer becomes the default
+#define ACTION_LED          0x14    // lighting control, see led_adjust_hue()
+#define ACTION_MACRO        0x15    // play a macro, see macro.h
+#define ACTION(action, arg) ((Keycode)((action) << 8 | (arg)))
+#define MO(layer)           ACTION(ACTION_MO, layer)
+#define TG(layer)           ACTION(ACTION_TG, layer)
+#define OSL(layer)          ACTION(ACTION_OSL, layer)
+#define DF(layer)           ACTION(ACTION_DF, layer)
+#define LED_HUI             ACTION(ACTION_LED, 0)
+#define LED_HUD             ACTION(ACTION_LED, 1)
+#define LED_SAI             ACTION(ACTION_LED, 2)
+#define LED_SAD             ACTION(ACTION_LED, 3)
+#define LED_VAI             ACTION(ACTION_LED, 4)
+#define LED_VAD             ACTION(ACTION_LED, 5)
+#define MACRO(n)            ACTION(ACTION_MACRO, n)         // keymap.txt macro n
+#define EMACRO(n)           ACTION(ACTION_MACRO, 0x80 | (n)) // EEPROM macro n
+
+#define IS_ACTION(code)     ((code) >= 0x1000)
+#define KEYCODE_ACTION(code) ((uint8_t)((code) >> 8))
+#define KEYCODE_ARG(code)   ((uint8_t)(code))
+#define KEYCODE_USAGE(code) ((uint8_t)(code))
+#define KEYCODE_MODS(code)  ((uint8_t)((code) >> 8))    // unless IS_ACTION
+
+/* Modifier usages 0xE0-0xE7 map onto bits 0-7 of the modifier byte, and
+   USAGE_MAX is the last usage with a bit in the NKRO report */
+#define USAGE_MAX           0xE7
+#define IS_MODIFIER(code)   ((code) >= 0xE0 && (code) <= USAGE_MAX)
+#define MODIFIER_BIT(code)  (1<<((code) - 0xE0))
+
+#define KEYMAP_BYTES        ((NKEY+7)/8)
+#define KEYMAP_DENSE        0xFF
+
+/* A layer is stored dense, NKEY codes indexed by key_id, or sparse, as a
+   presence bitmap over key_ids followed by only the codes of the keys that
+   exist.  keymap_rank[][i] counts the keys present in the bitmap bytes
+   before i, so a sparse lookup is still O(1): one bitmap byte, one rank
+   byte and a popcount of the bits below the key. */
+typedef struct {
+  uint16_t codes;       // first code of the layer in keymap_codes[]
+  uint8_t sparse;       // row of keymap_present/keymap_rank, or KEYMAP_DENSE
+} KeymapLayer;
+
+extern const KeymapLayer PROGMEM keymap_layers[MODES];
+extern const uint8_t PROGMEM keymap_present[][KEYMAP_BYTES];
+extern const uint8_t PROGMEM keymap_rank[][KEYMAP_BYTES];
+extern const uint8_t PROGMEM keymap_popcount[16];
+extern const Keycode PROGMEM keymap_codes[];
+
+// code of key_id in one layer, NA where the layer has no key there
+static inline Keycode keymap_code(uint8_t mode, uint8_t key_id)
+{
+  const KeymapLayer *layer = &keymap_layers[mode];
+  uint16_t codes = pgm_read_word(&layer->codes);
+  uint8_t sparse = pgm_read_byte(&layer->sparse);
+  uint8_t byte = key_id >> 3, bit = 1 << (key_id & 7);
+  uint8_t present, below;
+
+  if(sparse == KEYMAP_DENSE)
+    return pgm_read_word(&keymap_codes[codes + key_id]);
+  present = pgm_read_byte(&keymap_present[sparse][byte]);
+  if(!(present & bit)) return NA;
+  below = present & (bit - 1);
+  codes += pgm_read_byte(&keymap_rank[sparse][byte])
+         + pgm_read_byte(&keymap_popcount[below & 0x0F])
+         + pgm_read_byte(&keymap_popcount[below >> 4]);
+  return pgm_read_word(&keymap_codes[codes]);
+}
+#endif
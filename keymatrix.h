@@ -0,0 +1,65 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Bit packed key state: one row mask per column, bit r of col[c] is the
+// key with key_id c*NROW+r.  NROW fits in a byte, so NKEY keys take NCOL
+// bytes and "any key down" or "what changed" are byte operations.
+
+#ifndef __KEYMATRIX__
+#define __KEYMATRIX__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+
+#if NROW > 8
+#error "KeyMatrix holds at most 8 rows per column"
+#endif
+
+typedef struct {
+  uint8_t col[NCOL];
+} KeyMatrix;
+
+static inline void keymatrix_clear(KeyMatrix *m)
+{
+  for (uint8_t c=0; c<NCOL; c++) m->col[c] = 0;
+}
+
+static inline bool keymatrix_test(const KeyMatrix *m, uint8_t col, uint8_t row)
+{
+  return (m->col[col] >> row) & 1;
+}
+
+static inline void keymatrix_set(KeyMatrix *m, uint8_t col, uint8_t row)
+{
+  m->col[col] |= 1<<row;
+}
+
+static inline void keymatrix_reset(KeyMatrix *m, uint8_t col, uint8_t row)
+{
+  m->col[col] &= ~(1<<row);
+}
+
+// true if any key in the matrix is set
+static inline bool keymatrix_any(const KeyMatrix *m)
+{
+  uint8_t any = 0;
+  for (uint8_t c=0; c<NCOL; c++) any |= m->col[c];
+  return any != 0;
+}
+
+// row mask of the keys in one column that differ between a and b
+static inline uint8_t keymatrix_changed(const KeyMatrix *a, const KeyMatrix *b, uint8_t col)
+{
+  return a->col[col] ^ b->col[col];
+}
+
+// Take the lowest set bit out of a row mask and return its row, so
+//   while (mask) { row = keymatrix_pop(&mask); ... }
+// visits every set bit once, lowest row first.
+static inline uint8_t keymatrix_pop(uint8_t *mask)
+{
+  uint8_t row = __builtin_ctz(*mask);
+  *mask &= *mask - 1;
+  return row;
+}
+#endif
@@ -0,0 +1,115 @@
+/* Layer stack for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "layer.h"
+#include "led.h"
+#include "debug.h"
+#include "settings.h"
+#include "remap.h"
+
+uint8_t mode = 0;
+uint8_t layer_active = 0;
+uint8_t layer_default = 0;
+Keycode layer_keys[NKEY];
+
+/* A one-shot layer stays on from the OSL press until the key pressed
+   after it is released, oneshot_key is that key or 255 before it */
+static uint8_t oneshot_layers = 0;
+static uint8_t oneshot_key = 255;
+
+void layer_init(void) {
+  layer_active = 0;
+  layer_default = 0;
+  oneshot_layers = 0;
+  oneshot_key = 255;
+  layer_update();
+}
+
+/* Every key walks down from the top layer that is on, skipping layers that
+   are off, to the first one that is not transparent there.  It costs a
+   few keymap lookups a key, but only when a layer key is used. */
+void layer_update(void) {
+  uint8_t layers = layer_active | 1<<layer_default;
+  uint8_t key_id, layer, top;
+  Keycode code;
+
+  for(layer=MODES-1; layer>0; layer--) if(layers & 1<<layer) break;
+  top = layer;
+  for(key_id=0; key_id<NKEY; key_id++) {
+    code = NA;
+    for(layer=top+1; layer-->0; ) {
+      if(!(layers & 1<<layer)) continue;
+      code = remap_code(layer, key_id);
+      if(code != TRNS) break;
+      code = NA;
+    }
+    layer_keys[key_id] = code;
+  }
+  if(top != mode) {
+    mode = top;
+    changeIndicatorColor();
+    debug_log1(LOG_MODE, mode);
+  }
+}
+
+void layer_action(Keycode code, bool pressed) {
+  uint8_t bit = 1<<KEYCODE_ARG(code);
+
+  if(KEYCODE_ARG(code) >= MODES) return;
+  switch(KEYCODE_ACTION(code)) {
+    case ACTION_MO:
+      if(pressed) layer_active |= bit;
+      else layer_active &= ~bit;
+      break;
+    case ACTION_TG:
+      if(!pressed) return;
+      layer_active ^= bit;
+      break;
+    case ACTION_OSL:
+      if(!pressed) return;
+      layer_active |= bit;
+      oneshot_layers |= bit;
+      oneshot_key = 255;
+      break;
+    case ACTION_DF:
+      if(!pressed) return;
+      layer_default = KEYCODE_ARG(code);
+      settings_changed();
+      break;
+    default:
+      return;
+  }
+  layer_update();
+}
+
+void layer_key(uint8_t key_id, bool pressed) {
+  if(!oneshot_layers) return;
+  if(pressed) {
+    if(oneshot_key == 255) oneshot_key = key_id;
+  } else if(key_id == oneshot_key) {
+    layer_active &= ~oneshot_layers;
+    oneshot_layers = 0;
+    oneshot_key = 255;
+    layer_update();
+  }
+}
@@ -0,0 +1,51 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Layer stack: which layers are on, and the keycode each key resolves to.
+//
+// The default layer sits at the bottom and every layer that is on covers
+// the ones numbered below it.  TRNS positions show the next layer down.
+// The resolved keycode of every key is kept in a table that is rebuilt
+// when the stack changes, so looking a key up is one array read.
+
+#ifndef __LAYER__
+#define __LAYER__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+#include "keymap.h"
+
+#if MODES > 8
+#error "layer_active holds at most 8 layers"
+#endif
+
+/* Top layer that is on, the one the LEDs show */
+extern uint8_t mode;
+
+/* Bit n set while layer n is on through MO, TG or OSL */
+extern uint8_t layer_active;
+
+/* Layer at the bottom of the stack, set by DF */
+extern uint8_t layer_default;
+
+// default layer only, and resolve every key
+void layer_init(void);
+
+// re-resolve every key after the stack or the keymap changed
+void layer_update(void);
+
+/* Resolved keycode of every key_id, never TRNS, read with layer_code() */
+extern Keycode layer_keys[NKEY];
+
+// keycode of key_id through the current stack, NA if none
+static inline Keycode layer_code(uint8_t key_id) {
+  return layer_keys[key_id];
+}
+
+// run an MO/TG/OSL/DF keycode on its key's press or release
+void layer_action(Keycode code, bool pressed);
+
+// tell the stack key_id was pressed or released, so a one-shot layer
+// lasts exactly one key
+void layer_key(uint8_t key_id, bool pressed);
+#endif
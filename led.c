@@ -0,0 +1,159 @@
+/* RGB LED colour handling for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "led.h"
+#include "hal.h"
+#include "layer.h"
+#include "usb_keyboard.h"
+#include "settings.h"
+
+/* Layer indicator colours, one per layer, see changeIndicatorColor() */
+static const uint8_t main_max[RGB] = { IND_LEVEL, IND_LEVEL, IND_LEVEL };
+
+static const uint8_t main_red[RGB] = { IND_LEVEL, 0,         0 };
+static const uint8_t main_grn[RGB] = { 0,         IND_LEVEL, 0 };
+static const uint8_t main_blu[RGB] = { 0,         0,         IND_LEVEL };
+
+/* Main LED animation for each layer, ticked by led_tick() */
+LedLayer led_layers[MODES] = {
+  { LED_BREATHE,   {HUE_RED,   0, 255}, {0, 0, 0},           LED_PERIOD(FADE_TIME) },
+  { LED_CROSSFADE, {HUE_BLUE, 255, 255}, {HUE_CYAN, 255, 255}, LED_PERIOD(FADE_TIME) },
+  { LED_RAINBOW,   {HUE_RED, 255, 255},  {0, 0, 0},           LED_PERIOD(FADE_TIME*2) },
+  { LED_STATIC,    {HUE_GREEN, 255, 255}, {0, 0, 0},          0 },
+};
+
+/* Position in the current animation cycle, a full turn is 65536 */
+static uint16_t led_phase = 0;
+
+// 0 up to 255 and back down over one turn of phase
+static inline uint8_t triangle(uint16_t phase) {
+  uint16_t t = phase >> 7;
+  return t < 256 ? t : 511 - t;
+}
+
+// a + (b - a) * t/255 without the division
+static inline uint8_t lerp(uint8_t a, uint8_t b, uint8_t t) {
+  return ((uint16_t)a * (255 - t) + (uint16_t)b * t + 255) >> 8;
+}
+
+void setColor(uint8_t pwm, const uint8_t level[]) {
+  hal_pwm_write(pwm + redIndex,   level[redIndex]);
+  hal_pwm_write(pwm + greenIndex, level[greenIndex]);
+  hal_pwm_write(pwm + blueIndex,  level[blueIndex]);
+}
+
+void changeIndicatorColor(void) {
+  switch(mode) {
+    case 0:
+      setColor(PWM_IND(IND_LAYER), main_red);
+      break;
+    case 1:
+      setColor(PWM_IND(IND_LAYER), main_blu);
+      break;
+    case 2:
+      setColor(PWM_IND(IND_LAYER), main_max);
+      break;
+    case 3:
+      setColor(PWM_IND(IND_LAYER), main_grn);
+      break;
+    default:
+      setColor(PWM_IND(IND_LAYER), main_red);
+      break;
+  }
+}
+
+static inline uint8_t clamp8(int16_t n) {
+  return n < 0 ? 0 : n > 255 ? 255 : n;
+}
+
+void led_adjust_hue(int8_t delta) {
+  LedLayer *layer = &led_layers[mode];
+  layer->color.h += delta;
+  layer->color2.h += delta;
+  settings_changed();
+}
+
+void led_adjust_saturation(int8_t delta) {
+  LedLayer *layer = &led_layers[mode];
+  layer->color.s = clamp8(layer->color.s + delta);
+  layer->color2.s = clamp8(layer->color2.s + delta);
+  settings_changed();
+}
+
+void led_adjust_value(int8_t delta) {
+  LedLayer *layer = &led_layers[mode];
+  layer->color.v = clamp8(layer->color.v + delta);
+  layer->color2.v = clamp8(layer->color2.v + delta);
+  settings_changed();
+}
+
+void setIndicator(uint8_t ind, unsigned long int hex) {
+  hal_pwm_write(PWM_IND(ind) + redIndex,   getRed(hex));
+  hal_pwm_write(PWM_IND(ind) + greenIndex, getGreen(hex));
+  hal_pwm_write(PWM_IND(ind) + blueIndex,  getBlue(hex));
+}
+
+/* Host lock state on IND_LOCK, one colour a lock: num green, caps red,
+   scroll blue, mixing when several are on */
+static void showLocks(uint8_t leds) {
+  hal_pwm_write(PWM_IND(IND_LOCK) + redIndex,   leds & (1<<1) ? IND_LEVEL : 0);
+  hal_pwm_write(PWM_IND(IND_LOCK) + greenIndex, leds & (1<<0) ? IND_LEVEL : 0);
+  hal_pwm_write(PWM_IND(IND_LOCK) + blueIndex,  leds & (1<<2) ? IND_LEVEL : 0);
+}
+
+void led_tick(void) {
+  static uint8_t locks_shown = 0xFF;
+  const LedLayer *layer = &led_layers[mode];
+  uint8_t rgb[RGB], to[RGB], level;
+  Hsv hsv;
+
+  if(keyboard_leds != locks_shown) {
+    locks_shown = keyboard_leds;
+    showLocks(locks_shown);
+  }
+
+  led_phase += layer->step;
+  switch(layer->effect) {
+    case LED_BREATHE:
+      hsv = layer->color;
+      hsv.v = scale8(hsv.v, triangle(led_phase));
+      hsvToRgb(hsv, rgb);
+      break;
+    case LED_CROSSFADE:
+      level = triangle(led_phase);
+      hsvToRgb(layer->color, rgb);
+      hsvToRgb(layer->color2, to);
+      for(uint8_t i=0; i<RGB; i++) rgb[i] = lerp(rgb[i], to[i], level);
+      break;
+    case LED_RAINBOW:
+      hsv = layer->color;
+      hsv.h += led_phase >> 8;
+      hsvToRgb(hsv, rgb);
+      break;
+    default:
+      hsvToRgb(layer->color, rgb);
+      break;
+  }
+  hal_pwm_write(PWM_MAIN + redIndex,   rgb[redIndex]);
+  hal_pwm_write(PWM_MAIN + greenIndex, rgb[greenIndex]);
+  hal_pwm_write(PWM_MAIN + blueIndex,  rgb[blueIndex]);
+}
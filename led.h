@@ -0,0 +1,82 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Main and indicator RGB LED colour state
+
+#ifndef __LED__
+#define __LED__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+
+#define redIndex        0
+#define greenIndex      1
+#define blueIndex       2
+
+#define WHITE    0xFFFFFF
+#define RED      0xFF0000
+#define GREEN    0x00FF00
+#define BLUE     0x0000FF
+#define YELLOW   0xFFFF00
+#define PURPLE   0xFF00FF
+#define CYAN     0x00FFFF
+#define BLACK    0x000000
+
+/* Hues for Hsv colours, see hsvToRgb() */
+#define HUE_RED         0
+#define HUE_YELLOW      43
+#define HUE_GREEN       85
+#define HUE_CYAN        128
+#define HUE_BLUE        171
+#define HUE_PURPLE      213
+
+/* Main LED effects.  Each runs off a 16 bit phase that led_tick() advances
+   by the layer's step, so one full cycle takes 65536/step ticks. */
+typedef enum {
+  LED_STATIC,           // color, steady
+  LED_BREATHE,          // black up to color and back
+  LED_CROSSFADE,        // color over to color2 and back
+  LED_RAINBOW,          // round the hue circle from color's, at its s and v
+} LedEffect;
+
+// phase step for an effect that cycles every s seconds
+#define LED_PERIOD(s)   ((uint16_t)(65536UL / ((s) * LED_HZ)))
+
+typedef struct {
+  uint8_t effect;               // LedEffect
+  Hsv color;
+  Hsv color2;
+  uint16_t step;
+} LedLayer;
+
+// animation for each layer, picked by the current mode
+extern LedLayer led_layers[MODES];
+
+/* Runtime lighting controls for the current layer's colours.  Hue wraps
+   round, saturation and value stop at 0 and 255.  They only store bytes
+   led_tick() reads, so they are safe from the main loop. */
+#define LED_ADJUST_STEP 16      // per press of an LED_ keycode
+void led_adjust_hue(int8_t delta);
+void led_adjust_saturation(int8_t delta);
+void led_adjust_value(int8_t delta);
+
+/* The three indicators, see PWM_IND() */
+#define IND_LAYER       0       // current layer, changeIndicatorColor()
+#define IND_LOCK        1       // host num/caps/scroll lock, kept by led_tick()
+#define IND_MACRO       2       // macro and record status
+
+/* Indicator brightness.  Levels are perceptual (see hal_pwm_write), 0x26
+   lights an LED for about 4/255 of its share of the time. */
+#define IND_LEVEL       0x26
+
+// PWM levels of one LED group, red, green and blue
+void setColor(uint8_t pwm, const uint8_t level[]);
+void changeIndicatorColor(void);
+
+// light indicator ind with a 0xRRGGBB colour, as is, no IND_LEVEL scaling
+void setIndicator(uint8_t ind, unsigned long int hex);
+
+// advance the current layer's effect one frame and update the main LEDs;
+// the HAL calls it LED_HZ times a second from the PWM timer interrupt
+void led_tick(void);
+#endif
@@ -0,0 +1,224 @@
+/* Macro playback for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "macro.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "usb_keyboard.h"
+#include "debug.h"
+
+#define SHIFTED             0x80
+
+/* Offsets into the EEPROM macros, save_from and the loops over them are
+   8 bits and have to reach MACRO_EEPROM_SIZE itself */
+#if MACRO_EEPROM_SIZE > 255
+#error "the EEPROM macros are too big for 8 bit offsets"
+#endif
+
+/* Usage of each character ' '..'~' on a US layout, SHIFTED when it needs
+   the shift key */
+static const uint8_t PROGMEM ascii_usage[] = {
+  KEY_SPACE,          KEY_1|SHIFTED,      KEY_QUOTE|SHIFTED,  KEY_3|SHIFTED,      // space ! " #
+  KEY_4|SHIFTED,      KEY_5|SHIFTED,      KEY_7|SHIFTED,      KEY_QUOTE,          // $ % & '
+  KEY_9|SHIFTED,      KEY_0|SHIFTED,      KEY_8|SHIFTED,      KEY_EQUAL|SHIFTED,  // ( ) * +
+  KEY_COMMA,          KEY_MINUS,          KEY_PERIOD,         KEY_SLASH,          // , - . /
+  KEY_0,              KEY_1,              KEY_2,              KEY_3,              // 0 1 2 3
+  KEY_4,              KEY_5,              KEY_6,              KEY_7,              // 4 5 6 7
+  KEY_8,              KEY_9,              KEY_SEMICOLON|SHIFTED, KEY_SEMICOLON,   // 8 9 : ;
+  KEY_COMMA|SHIFTED,  KEY_EQUAL,          KEY_PERIOD|SHIFTED, KEY_SLASH|SHIFTED,  // < = > ?
+  KEY_2|SHIFTED,      KEY_A|SHIFTED,      KEY_B|SHIFTED,      KEY_C|SHIFTED,      // @ A B C
+  KEY_D|SHIFTED,      KEY_E|SHIFTED,      KEY_F|SHIFTED,      KEY_G|SHIFTED,      // D E F G
+  KEY_H|SHIFTED,      KEY_I|SHIFTED,      KEY_J|SHIFTED,      KEY_K|SHIFTED,      // H I J K
+  KEY_L|SHIFTED,      KEY_M|SHIFTED,      KEY_N|SHIFTED,      KEY_O|SHIFTED,      // L M N O
+  KEY_P|SHIFTED,      KEY_Q|SHIFTED,      KEY_R|SHIFTED,      KEY_S|SHIFTED,      // P Q R S
+  KEY_T|SHIFTED,      KEY_U|SHIFTED,      KEY_V|SHIFTED,      KEY_W|SHIFTED,      // T U V W
+  KEY_X|SHIFTED,      KEY_Y|SHIFTED,      KEY_Z|SHIFTED,      KEY_LEFT_BRACE,     // X Y Z [
+  KEY_BACKSLASH,      KEY_RIGHT_BRACE,    KEY_6|SHIFTED,      KEY_MINUS|SHIFTED,  // \ ] ^ _
+  KEY_TILDE,          KEY_A,              KEY_B,              KEY_C,              // ` a b c
+  KEY_D,              KEY_E,              KEY_F,              KEY_G,              // d e f g
+  KEY_H,              KEY_I,              KEY_J,              KEY_K,              // h i j k
+  KEY_L,              KEY_M,              KEY_N,              KEY_O,              // l m n o
+  KEY_P,              KEY_Q,              KEY_R,              KEY_S,              // p q r s
+  KEY_T,              KEY_U,              KEY_V,              KEY_W,              // t u v w
+  KEY_X,              KEY_Y,              KEY_Z,              KEY_LEFT_BRACE|SHIFTED, // x y z {
+  KEY_BACKSLASH|SHIFTED, KEY_RIGHT_BRACE|SHIFTED, KEY_TILDE|SHIFTED               // | } ~
+};
+
+/* RAM copy of the EEPROM macros; bytes from save_from on may still differ
+   from the EEPROM while unsaved is set */
+static uint8_t eeprom_steps[MACRO_EEPROM_SIZE];
+static bool unsaved = false;
+static uint8_t save_from;
+
+/* The macro playing: where its steps are, 0 for none, the next one, how
+   many frames are left of a MACRO_WAIT, the key a tap or character
+   releases next frame, and the frame of the last step */
+#define FROM_FLASH          1
+#define FROM_EEPROM         2
+static uint8_t source = 0;
+static uint16_t pos;
+static uint8_t wait;
+static Keycode tapped;
+static uint8_t last_frame;
+
+/* Usages held by MACRO_DOWN, released at the end; 0xE0-0xE7 included */
+static uint8_t held[NKRO_KEYS_BYTES+1];
+
+void macro_load(void) {
+  for(uint8_t i=0; i<MACRO_EEPROM_SIZE; i++)
+    eeprom_steps[i] = hal_eeprom_read(MACRO_EEPROM_START + i);
+}
+
+static inline uint8_t next_byte(void) {
+  if(source == FROM_FLASH) return pgm_read_byte(&macro_steps[pos++]);
+  return pos < MACRO_EEPROM_SIZE ? eeprom_steps[pos++] : MACRO_END;
+}
+
+static void stop(void) {
+  uint8_t usage;
+  if(tapped) keyboard_up(tapped);
+  tapped = 0;
+  for(usage=0; usage<=USAGE_MAX; usage++)
+    if(held[usage>>3] & 1<<(usage&7)) keyboard_up(usage);
+  for(usage=0; usage<sizeof(held); usage++) held[usage] = 0;
+  source = 0;
+  setIndicator(IND_MACRO, 0);
+  send();
+}
+
+void macro_play(uint8_t n) {
+  uint8_t op, i;
+
+  if(source) {
+    stop();
+    return;
+  }
+  if(n & MACRO_EEPROM) {
+    // the nth macro of the EEPROM set, skipping the ones before it
+    pos = 0;
+    source = FROM_EEPROM;
+    for(i = n & ~MACRO_EEPROM; i && pos < MACRO_EEPROM_SIZE; i--)
+      while((op = next_byte()) != MACRO_END)
+        if(op <= MACRO_WAIT) next_byte();
+    if(pos >= MACRO_EEPROM_SIZE) {
+      source = 0;
+      return;
+    }
+  } else {
+    if(n >= macro_count) return;
+    pos = pgm_read_word(&macro_index[n]);
+    source = FROM_FLASH;
+  }
+  wait = 0;
+  last_frame = usb_frame();
+  setIndicator(IND_MACRO, MACRO_IND_COLOR);
+  debug_log1(LOG_MACRO, n);
+}
+
+// one report's worth of the macro
+static void step(void) {
+  uint8_t op, usage, down;
+
+  if(wait) {
+    wait--;
+    return;
+  }
+  if(tapped) {
+    keyboard_up(tapped);
+    tapped = 0;
+    return;
+  }
+  op = next_byte();
+  switch(op) {
+    case MACRO_DOWN:
+    case MACRO_UP:
+      // only a change of what the macro holds counts
+      usage = next_byte();
+      if(usage > USAGE_MAX) return;
+      down = held[usage>>3] & 1<<(usage&7);
+      if(op == MACRO_DOWN ? down : !down) return;
+      held[usage>>3] ^= 1<<(usage&7);
+      if(op == MACRO_DOWN) keyboard_down(usage);
+      else keyboard_up(usage);
+      return;
+    case MACRO_TAP:
+      usage = next_byte();
+      if(usage > USAGE_MAX) return;
+      tapped = usage;
+      break;
+    case MACRO_WAIT:
+      wait = next_byte();
+      if(wait) wait--;               // this frame is the first
+      return;
+    case '\t':
+      tapped = KEY_TAB;
+      break;
+    case '\n':
+      tapped = KEY_ENTER;
+      break;
+    default:
+      if(op < ' ' || op > '~') {
+        stop();
+        return;
+      }
+      usage = pgm_read_byte(&ascii_usage[op - ' ']);
+      tapped = usage & SHIFTED ? S(usage & ~SHIFTED) : usage;
+      break;
+  }
+  if(tapped) keyboard_down(tapped);
+}
+
+bool macro_store(uint8_t offset, const uint8_t *data, uint8_t count) {
+  if(offset >= MACRO_EEPROM_SIZE || count > MACRO_EEPROM_SIZE - offset) return false;
+  if(source == FROM_EEPROM) stop();
+  for(uint8_t i=0; i<count; i++) eeprom_steps[offset + i] = data[i];
+  if(!unsaved || offset < save_from) save_from = offset;
+  unsaved = true;
+  return true;
+}
+
+// write the first EEPROM byte that differs from the RAM copy
+static void save_step(void) {
+  if(!unsaved || !hal_eeprom_ready()) return;
+  while(save_from < MACRO_EEPROM_SIZE
+        && hal_eeprom_read(MACRO_EEPROM_START + save_from) == eeprom_steps[save_from])
+    save_from++;
+  if(save_from == MACRO_EEPROM_SIZE) {
+    unsaved = false;
+    return;
+  }
+  hal_eeprom_write(MACRO_EEPROM_START + save_from, eeprom_steps[save_from]);
+  save_from++;
+}
+
+void macro_task(void) {
+  uint8_t frame = usb_frame();
+
+  // the last report must be out of the way, one step a frame after it
+  if(source && frame != last_frame && !report_dirty) {
+    last_frame = frame;
+    step();
+    send();
+  }
+  save_step();
+}
@@ -0,0 +1,64 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Macros: steps typed out one report per USB frame from the main loop, so
+// a long macro goes at the full 1000 reports a second while the scan and
+// the other keys carry on.
+//
+// A macro is a string of steps ending with MACRO_END.  An op byte takes
+// one argument byte; any other byte is a character typed as on a US
+// layout.  Flash macros are compiled from the "macro" lines of keymap.txt
+// by tools/keymapgen.py and bound with MACRO(n).  EEPROM macros are
+// written with tools/remap.py, bound with EMACRO(n), and kept in a RAM
+// copy that is played from and saved a byte at a time.
+//
+// The keys a macro presses go through the same reference counts as the
+// real keys (see keyboard.c), so a macro never releases a key that is
+// still held, and whatever it left down is released when it ends.
+
+#ifndef __MACRO__
+#define __MACRO__
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "config.h"
+#include "util.h"
+#include "hal.h"
+#include "led.h"
+#include "remap.h"
+
+/* Steps, each a report */
+#define MACRO_END           0
+#define MACRO_DOWN          1       // usage: press it
+#define MACRO_UP            2       // usage: release it
+#define MACRO_TAP           3       // usage: press it, release it next frame
+#define MACRO_WAIT          4       // frames (ms), 1-255: send nothing
+// '\t', '\n' and ' '..'~' type that character, pressing and releasing it
+
+/* Macro argument of the keycode: bit 7 picks the EEPROM set */
+#define MACRO_EEPROM        0x80
+
+/* EEPROM macros, one after the other, after the keymap overlays */
+#define MACRO_EEPROM_START  (REMAP_START + 2 * MODES * REMAP_COPY_SIZE)
+#define MACRO_EEPROM_SIZE   (HAL_EEPROM_SIZE - MACRO_EEPROM_START)
+
+/* Lights IND_MACRO while a macro plays */
+#define MACRO_IND_COLOR     ((unsigned long)IND_LEVEL << 8)
+
+/* Flash macros, generated into keymap.c */
+extern const uint8_t PROGMEM macro_steps[];
+extern const uint16_t PROGMEM macro_index[];
+extern const uint8_t macro_count;
+
+// load the EEPROM macros
+void macro_load(void);
+
+// start macro n of MACRO(n)/EMACRO(n), or stop it if one is playing
+void macro_play(uint8_t n);
+
+// store count bytes at offset into the EEPROM macros, false if they do
+// not fit; stops an EEPROM macro that is playing
+bool macro_store(uint8_t offset, const uint8_t *data, uint8_t count);
+
+// main loop: play the next step once a frame, save changed EEPROM bytes
+void macro_task(void);
+#endif
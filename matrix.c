@@ -0,0 +1,134 @@
+/* Matrix scanning for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "matrix.h"
+#include "keyboard.h"
+#include "hal.h"
+#include "stats.h"
+
+#define DEBOUNCE_TICKS  (DEBOUNCE_MS * SCAN_HZ / 1000)
+#if DEBOUNCE_TICKS < 1 || DEBOUNCE_TICKS > 255
+#error "DEBOUNCE_MS does not fit in a scan tick count"
+#endif
+
+/* matrix_sample() runs from the scan timer interrupt and ORs the closed rows
+   of each column into matrix_snapshot, so a tap shorter than the main loop's
+   latency is still seen.  matrix_ticks counts samples and is the time base
+   for debouncing.  matrix_task() takes the snapshot and clears it. */
+static volatile uint8_t matrix_snapshot[NCOL];
+static volatile uint8_t matrix_ticks;
+static uint8_t last_ticks;
+
+/* hal_timer_now() when the first sample went into the current snapshot */
+static volatile uint16_t snapshot_at;
+static volatile bool snapshot_fresh;
+
+/* Debouncing is eager on press, deferred on release.  Each column of the
+   snapshot is XORed against matrix_state, the debounced key state, and only
+   the differing bits are visited, so an idle column costs one compare.  A
+   bit that is closed but not yet pressed is a press and is reported at once.
+   A bit that is pressed but read open is a pending release: opened_at is
+   stamped on the first open reading (the key was closed in matrix_prev) and
+   the key is released once it has stayed open for DEBOUNCE_TICKS, which
+   swallows the chatter of both edges.  key_press() and key_release() only
+   update the key state; a pass that changed anything ends in one send().
+   If that report could not be queued the snapshot is left alone until it
+   is, taps keep accumulating in it, so no transition is lost. */
+KeyMatrix matrix_state;
+static KeyMatrix matrix_prev;
+uint8_t opened_at[NKEY];
+
+void matrix_init(void) {
+  uint8_t i;
+  for(i=0; i<NKEY; i++) opened_at[i] = 0;
+  for(i=0; i<NCOL; i++) matrix_snapshot[i] = 0;
+  keymatrix_clear(&matrix_state);
+  keymatrix_clear(&matrix_prev);
+  last_ticks = matrix_ticks;
+  snapshot_fresh = true;
+}
+
+void matrix_sample(void) {
+  uint8_t col;
+  uint16_t start = hal_timer_now();
+
+  for(col=0; col<NCOL; col++) {
+    hal_matrix_select(col);
+    matrix_snapshot[col] |= hal_matrix_read_rows();
+    hal_matrix_unselect(col);
+  }
+  matrix_ticks++;
+  if(snapshot_fresh) {
+    snapshot_at = start;
+    snapshot_fresh = false;
+  }
+  stats_record(STATS_SCAN, hal_timer_now() - start);
+}
+
+void matrix_task(void) {
+  uint8_t row, col, key_id, now, intr_state, delta;
+  uint16_t start, sampled_at;
+  bool changed = false;
+  KeyMatrix closed;
+
+  if(matrix_ticks == last_ticks) return;
+  if(report_dirty) {
+    send();
+    if(report_dirty) return;
+  }
+  intr_state = hal_irq_save();
+  now = matrix_ticks;
+  for(col=0; col<NCOL; col++) {
+    closed.col[col] = matrix_snapshot[col];
+    matrix_snapshot[col] = 0;
+  }
+  sampled_at = snapshot_at;
+  snapshot_fresh = true;
+  hal_irq_restore(intr_state);
+  last_ticks = now;
+  start = hal_timer_now();
+
+  for(col=0; col<NCOL; col++) {
+    delta = keymatrix_changed(&closed, &matrix_state, col);
+    while(delta) {
+      row = keymatrix_pop(&delta);
+      key_id = col*NROW+row;
+      if(keymatrix_test(&closed, col, row)) {
+        keymatrix_set(&matrix_state, col, row);
+        key_press(key_id);
+        changed = true;
+      } else if(keymatrix_test(&matrix_prev, col, row)) {
+        opened_at[key_id] = now;
+      } else if((uint8_t)(now - opened_at[key_id]) >= DEBOUNCE_TICKS) {
+        keymatrix_reset(&matrix_state, col, row);
+        key_release(key_id);
+        changed = true;
+      }
+    }
+  }
+  matrix_prev = closed;
+  if(changed) {
+    stats_edge = sampled_at;
+    send();
+  }
+  stats_record(STATS_PASS, hal_timer_now() - start);
+}
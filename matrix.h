@@ -0,0 +1,19 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Matrix scanning and per-key debouncing
+
+#ifndef __MATRIX__
+#define __MATRIX__
+
+#include <stdint.h>
+#include "config.h"
+#include "keymatrix.h"
+
+/* Debounced key state: which keys are down */
+extern KeyMatrix matrix_state;
+
+void matrix_init(void);
+void matrix_sample(void);       // scan timer interrupt: read every column
+void matrix_task(void);         // main loop: debounce and dispatch new samples
+
+#endif
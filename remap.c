@@ -0,0 +1,398 @@
+/* Runtime keymap overlay for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "remap.h"
+#include "hal.h"
+#include "layer.h"
+#include "debug.h"
+#include "macro.h"
+
+#if REMAP_START + 2 * MODES * REMAP_COPY_SIZE > HAL_EEPROM_SIZE
+#error "the keymap overlays do not fit in the EEPROM"
+#endif
+
+#if REMAP_SLOTS < 1 || REMAP_SLOTS > MODES
+#error "REMAP_SLOTS must be from 1 to MODES"
+#endif
+
+uint8_t remap_layers = 0;
+uint8_t remap_slot[MODES];
+Keycode remap_codes[REMAP_SLOTS][NKEY];
+
+/* The newer EEPROM copy of each layer and its sequence number, the next
+   save goes into the other copy */
+static uint8_t newest_copy[MODES];
+static uint8_t newest_seq[MODES];
+
+/* Command mailbox between the USB interrupt and the main loop */
+static volatile bool requested = false;
+static volatile uint8_t request[REMAP_REPORT_SIZE];
+static volatile uint8_t reply[REMAP_REPORT_SIZE];
+
+/* The command being run, over several passes when it writes the EEPROM,
+   and its reply */
+static bool running = false;
+static uint8_t command[REMAP_REPORT_SIZE], result[REMAP_REPORT_SIZE];
+
+/* Upload: the layer, 0xFF for none, the key_id the next WRITE starts at
+   and the CRC so far.  The codes go straight into the older EEPROM copy
+   of the layer and only take RAM once COMMIT reads them back. */
+static uint8_t upload_layer = 0xFF, upload_next;
+static uint16_t upload_crc;
+static uint8_t upload_bytes[4];         // the header, then the CRC
+
+/* Bytes the running command still has to write into the upload copy,
+   one a pass, and where the next one goes */
+static const uint8_t *stage_data;
+static uint8_t stage_count;
+static uint16_t stage_addr;
+
+/* Saving: layers still to save, and the copy being written, 0xFF for
+   none.  The CRC is worked out as the bytes go out. */
+static uint8_t unsaved = 0;
+static uint8_t saving = 0xFF;
+static uint8_t save_copy, save_header[4];
+static uint16_t save_pos, save_crc;
+
+static inline uint16_t copy_addr(uint8_t layer, uint8_t copy) {
+  return REMAP_START + (uint16_t)(layer*2 + copy) * REMAP_COPY_SIZE;
+}
+
+/* A usage past USAGE_MAX has no bit in the report and an action byte past
+   ACTION_MACRO nothing to run, so neither gets into an overlay */
+static bool code_valid(Keycode code) {
+  uint8_t arg = KEYCODE_ARG(code);
+  if(!IS_ACTION(code)) return KEYCODE_USAGE(code) <= USAGE_MAX;
+  switch(KEYCODE_ACTION(code)) {
+    case ACTION_MO:
+    case ACTION_TG:
+    case ACTION_OSL:
+    case ACTION_DF:
+      return arg < MODES;
+    case ACTION_LED:
+      return arg <= KEYCODE_ARG(LED_VAD);
+    case ACTION_MACRO:
+      return true;
+  }
+  return false;
+}
+
+static bool copy_valid(uint8_t layer, uint8_t copy) {
+  uint16_t addr = copy_addr(layer, copy), crc = 0xFFFF, i;
+  if(hal_eeprom_read(addr) != REMAP_VERSION || hal_eeprom_read(addr + 1) != NKEY)
+    return false;
+  for(i=0; i<REMAP_COPY_SIZE-2; i++) crc = crc16_update(crc, hal_eeprom_read(addr + i));
+  return hal_eeprom_read(addr + i) == (uint8_t)crc
+      && hal_eeprom_read(addr + i + 1) == crc >> 8;
+}
+
+// a slot no overlaid layer uses, REMAP_SLOTS if there is none
+static uint8_t free_slot(void) {
+  uint8_t slot, layer;
+  for(slot=0; slot<REMAP_SLOTS; slot++) {
+    for(layer=0; layer<MODES; layer++)
+      if(remap_layers & 1<<layer && remap_slot[layer] == slot) break;
+    if(layer == MODES) break;
+  }
+  return slot;
+}
+
+// the slot a layer has, or would get if it were overlaid now
+static uint8_t layer_slot(uint8_t layer) {
+  if(remap_layers & 1<<layer) return remap_slot[layer];
+  return free_slot();
+}
+
+void remap_load(void) {
+  uint8_t layer, copy, seq[2], key_id, slot;
+  uint16_t addr;
+
+  remap_layers = 0;
+  for(layer=0; layer<MODES; layer++) {
+    for(copy=0; copy<2; copy++) seq[copy] = hal_eeprom_read(copy_addr(layer, copy) + 2);
+    // newer copy first, by sequence number, then the other
+    copy = (int8_t)(seq[1] - seq[0]) > 0;
+    if(!copy_valid(layer, copy)) copy ^= 1;
+    if(!copy_valid(layer, copy)) {
+      newest_copy[layer] = 1;
+      newest_seq[layer] = 0;
+      continue;
+    }
+    newest_copy[layer] = copy;
+    newest_seq[layer] = seq[copy];
+    addr = copy_addr(layer, copy);
+    if(!(hal_eeprom_read(addr + 3) & REMAP_OVERLAID)) continue;
+    // more overlays than slots, or codes from another firmware: keep the
+    // flash layer
+    slot = free_slot();
+    if(slot == REMAP_SLOTS) continue;
+    for(key_id=0; key_id<NKEY; key_id++) {
+      remap_codes[slot][key_id] = hal_eeprom_read(addr + 4 + 2*key_id)
+                                | hal_eeprom_read(addr + 5 + 2*key_id) << 8;
+      if(!code_valid(remap_codes[slot][key_id])) break;
+    }
+    if(key_id < NKEY) continue;
+    remap_slot[layer] = slot;
+    remap_layers |= 1<<layer;
+  }
+  debug_log1(LOG_REMAP, remap_layers);
+}
+
+void remap_request(const uint8_t *report) {
+  for(uint8_t i=0; i<REMAP_REPORT_SIZE; i++) request[i] = report[i];
+  requested = true;
+}
+
+void remap_reply(uint8_t *report) {
+  for(uint8_t i=0; i<REMAP_REPORT_SIZE; i++) report[i] = reply[i];
+}
+
+// queue a layer for saving, starting over if it was part way out; an
+// upload of the layer is dropped, the save goes into the same copy
+static void changed(uint8_t layer) {
+  unsaved |= 1<<layer;
+  if(saving == layer) saving = 0xFF;
+  if(upload_layer == layer) upload_layer = 0xFF;
+}
+
+// start overlaying a layer with its flash codes, false if no slot is free
+static bool overlay(uint8_t layer) {
+  uint8_t slot;
+  if(remap_layers & 1<<layer) return true;
+  slot = free_slot();
+  if(slot == REMAP_SLOTS) return false;
+  for(uint8_t key_id=0; key_id<NKEY; key_id++)
+    remap_codes[slot][key_id] = keymap_code(layer, key_id);
+  remap_slot[layer] = slot;
+  remap_layers |= 1<<layer;
+  return true;
+}
+
+// write the next staged byte when the EEPROM is free, true after the last
+static bool stage_step(void) {
+  uint8_t value;
+  if(!hal_eeprom_ready()) return false;
+  value = *stage_data++;
+  upload_crc = crc16_update(upload_crc, value);
+  hal_eeprom_write(stage_addr++, value);
+  return !--stage_count;
+}
+
+// stage count bytes for the upload copy, true once they are all out
+static bool stage(const uint8_t *data, uint8_t count) {
+  stage_data = data;
+  stage_count = count;
+  return !count || stage_step();
+}
+
+// run one command, in[] as it came, out[] zeroed; false while it still
+// has bytes to write or has to wait for the EEPROM, then it runs again
+static bool run(const uint8_t *in, uint8_t *out) {
+  uint8_t layer = in[2], key_id = in[3], count = in[4], i, slot;
+  uint16_t addr;
+  Keycode code;
+
+  if(stage_count) return stage_step();    // the rest of a BEGIN, WRITE or COMMIT
+  out[0] = in[0];
+  out[1] = in[1];
+  out[2] = REMAP_BAD_ARGUMENT;
+  switch(in[0]) {
+    case REMAP_CMD_INFO:
+      out[3] = NROW;
+      out[4] = NCOL;
+      out[5] = NKEY;
+      out[6] = MODES;
+      out[7] = remap_layers;
+      out[8] = REMAP_CODES;
+      out[9] = MACRO_EEPROM_SIZE;
+      out[10] = REMAP_SLOTS;
+      break;
+    case REMAP_CMD_GET:
+      if(layer >= MODES || key_id >= NKEY) return true;
+      code = remap_code(layer, key_id);
+      out[3] = code;
+      out[4] = code >> 8;
+      break;
+    case REMAP_CMD_SET:
+      code = in[4] | in[5] << 8;
+      if(layer >= MODES || key_id >= NKEY || !code_valid(code)) return true;
+      if(!overlay(layer)) {
+        out[2] = REMAP_NO_ROOM;
+        return true;
+      }
+      remap_codes[remap_slot[layer]][key_id] = code;
+      changed(layer);
+      layer_update();
+      break;
+    case REMAP_CMD_BEGIN:
+      if(layer >= MODES) return true;
+      if(layer_slot(layer) == REMAP_SLOTS) {
+        out[2] = REMAP_NO_ROOM;
+        return true;
+      }
+      // a save of the layer would go into the same copy, let it finish
+      if(unsaved & 1<<layer || saving == layer) return false;
+      upload_layer = layer;
+      upload_next = 0;
+      upload_crc = 0xFFFF;
+      upload_bytes[0] = REMAP_VERSION;
+      upload_bytes[1] = NKEY;
+      upload_bytes[2] = newest_seq[layer] + 1;
+      upload_bytes[3] = REMAP_OVERLAID;
+      stage_addr = copy_addr(layer, newest_copy[layer] ^ 1);
+      out[2] = REMAP_OK;
+      return stage(upload_bytes, 4);
+    case REMAP_CMD_WRITE:
+      // no layer argument, so everything is one byte earlier
+      key_id = in[2];
+      count = in[3];
+      if(upload_layer == 0xFF) {
+        out[2] = REMAP_NO_UPLOAD;
+        return true;
+      }
+      // in order, each WRITE where the last one ended
+      if(key_id != upload_next || count > REMAP_CODES || count > NKEY - key_id)
+        return true;
+      for(i=0; i<count; i++)
+        if(!code_valid(in[4+2*i] | in[5+2*i] << 8)) return true;
+      upload_next += count;
+      out[2] = REMAP_OK;
+      return stage(in + 4, 2*count);
+    case REMAP_CMD_COMMIT:
+      if(upload_layer == 0xFF) {
+        out[2] = REMAP_NO_UPLOAD;
+        return true;
+      }
+      layer = upload_layer;
+      if(upload_next < NKEY) return true;
+      slot = layer_slot(layer);
+      if(slot == REMAP_SLOTS) {
+        out[2] = REMAP_NO_ROOM;
+        return true;
+      }
+      if(!hal_eeprom_ready()) return false;
+      // switch to the uploaded codes, then seal the copy with its CRC
+      addr = copy_addr(layer, newest_copy[layer] ^ 1);
+      for(key_id=0; key_id<NKEY; key_id++)
+        remap_codes[slot][key_id] = hal_eeprom_read(addr + 4 + 2*key_id)
+                                  | hal_eeprom_read(addr + 5 + 2*key_id) << 8;
+      remap_slot[layer] = slot;
+      remap_layers |= 1<<layer;
+      layer_update();
+      newest_copy[layer] ^= 1;
+      newest_seq[layer] = upload_bytes[2];
+      upload_layer = 0xFF;
+      upload_bytes[0] = upload_crc;
+      upload_bytes[1] = upload_crc >> 8;
+      out[2] = REMAP_OK;
+      return stage(upload_bytes, 2);
+    case REMAP_CMD_READ:
+      if(layer >= MODES || count > REMAP_CODES || key_id >= NKEY || count > NKEY - key_id)
+        return true;
+      out[3] = key_id;
+      out[4] = count;
+      for(i=0; i<count; i++) {
+        code = remap_code(layer, key_id + i);
+        out[5+2*i] = code;
+        out[6+2*i] = code >> 8;
+      }
+      break;
+    case REMAP_CMD_RESET:
+      if(layer != 0xFF && layer >= MODES) return true;
+      for(i=0; i<MODES; i++) {
+        if(layer != 0xFF && i != layer) continue;
+        remap_layers &= ~(1<<i);
+        changed(i);
+      }
+      layer_update();
+      break;
+    case REMAP_CMD_MACROS:
+      // offset and count where layer and key_id are
+      if(key_id > REMAP_MACRO_BYTES || !macro_store(layer, in + 4, key_id)) return true;
+      break;
+    default:
+      out[2] = REMAP_BAD_COMMAND;
+      return true;
+  }
+  out[2] = REMAP_OK;
+  return true;
+}
+
+// next byte of the copy being saved: header, codes, CRC
+static uint8_t save_byte(uint16_t pos) {
+  Keycode code;
+  if(pos < 4) return save_header[pos];
+  pos -= 4;
+  if(pos < NKEY*2) {
+    if(!(remap_layers & 1<<saving)) return 0;
+    code = remap_codes[remap_slot[saving]][pos >> 1];
+    return pos & 1 ? code >> 8 : code;
+  }
+  return pos == NKEY*2 ? save_crc : save_crc >> 8;
+}
+
+static void save_step(void) {
+  uint8_t value;
+
+  if(saving == 0xFF) {
+    if(!unsaved) return;
+    for(saving=0; !(unsaved & 1<<saving); saving++);
+    unsaved &= ~(1<<saving);
+    save_copy = newest_copy[saving] ^ 1;
+    save_header[0] = REMAP_VERSION;
+    save_header[1] = NKEY;
+    save_header[2] = newest_seq[saving] + 1;
+    save_header[3] = remap_layers & 1<<saving ? REMAP_OVERLAID : 0;
+    save_pos = 0;
+    save_crc = 0xFFFF;
+  }
+  if(!hal_eeprom_ready()) return;
+  value = save_byte(save_pos);
+  if(save_pos < REMAP_COPY_SIZE-2) save_crc = crc16_update(save_crc, value);
+  hal_eeprom_write(copy_addr(saving, save_copy) + save_pos, value);
+  if(++save_pos < REMAP_COPY_SIZE) return;
+  newest_copy[saving] = save_copy;
+  newest_seq[saving] = save_header[2];
+  saving = 0xFF;
+}
+
+void remap_task(void) {
+  uint8_t i, intr_state;
+
+  // a new command waits until the running one has replied
+  if(!running && requested) {
+    intr_state = hal_irq_save();
+    for(i=0; i<REMAP_REPORT_SIZE; i++) command[i] = request[i];
+    requested = false;
+    hal_irq_restore(intr_state);
+    for(i=0; i<REMAP_REPORT_SIZE; i++) result[i] = 0;
+    running = true;
+  }
+  if(running && run(command, result)) {
+    running = false;
+    intr_state = hal_irq_save();
+    for(i=0; i<REMAP_REPORT_SIZE; i++) reply[i] = result[i];
+    hal_irq_restore(intr_state);
+  }
+  save_step();
+}
@@ -0,0 +1,92 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Runtime keymap changes, sent over the remap HID interface and kept in
+// EEPROM, so a key can be moved without reflashing.  tools/remap.py is the
+// host side.
+//
+// A layer the host has changed is overlaid on the flash keymap as a whole:
+// it gets one of REMAP_SLOTS rows of remap_codes for its NKEY codes and
+// remap_code() reads them in place of keymap_code().  Each layer has two
+// EEPROM copies with a sequence number and a CRC-16.  A save goes into the
+// older copy, so a power loss part way through leaves the other one to
+// boot from.  An upload is written straight into the older copy as it
+// arrives, so it needs no RAM of its own.
+//
+// Commands are feature reports of REMAP_REPORT_SIZE bytes: command, tag,
+// then arguments.  The USB interrupt only hands a command over, the main
+// loop runs it, and the reply is read back as a feature report: command,
+// tag, status, then results.  A host polls until the tag matches the one
+// it sent.  Codes are 16 bit little endian Keycodes, see keymap.h.
+
+#ifndef __REMAP__
+#define __REMAP__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+#include "keymap.h"
+#include "settings.h"
+
+#define REMAP_REPORT_SIZE   32
+#define REMAP_CODES         13      // codes in one WRITE or READ
+#define REMAP_MACRO_BYTES   28      // bytes in one MACROS
+
+/* Layers that can be overlaid at once, every one by default (912 bytes
+   of RAM with 4 layers of 114 keys).  A build short of RAM can set it
+   lower, a layer past the last slot then gets REMAP_NO_ROOM. */
+#ifndef REMAP_SLOTS
+#define REMAP_SLOTS         MODES
+#endif
+
+/* Commands and their arguments and results */
+#define REMAP_CMD_INFO      1       // -> NROW, NCOL, NKEY, MODES, overlaid layer mask, REMAP_CODES,
+                                    //    MACRO_EEPROM_SIZE, REMAP_SLOTS
+#define REMAP_CMD_GET       2       // layer, key_id -> code
+#define REMAP_CMD_SET       3       // layer, key_id, code: change one key and save
+#define REMAP_CMD_BEGIN     4       // layer: start an upload of the whole layer
+#define REMAP_CMD_WRITE     5       // key_id, count, codes: into the upload, in key_id order
+#define REMAP_CMD_COMMIT    6       // once all NKEY codes are written, switch to them at once
+#define REMAP_CMD_READ      7       // layer, key_id, count -> key_id, count, codes
+#define REMAP_CMD_RESET     8       // layer, 0xFF for all: back to the flash keymap
+#define REMAP_CMD_MACROS    9       // offset, count, bytes: into the EEPROM macros, see macro.h
+
+/* Reply status */
+#define REMAP_OK            0
+#define REMAP_BAD_COMMAND   1
+#define REMAP_BAD_ARGUMENT  2
+#define REMAP_NO_UPLOAD     3       // WRITE or COMMIT without a BEGIN, or after a SET or
+                                    // RESET of the layer
+#define REMAP_NO_ROOM       4       // every slot is taken, reset a layer first
+
+/* EEPROM layout, after the settings journal.  A copy is a version byte,
+   NKEY, a sequence number, a flags byte, the codes and the CRC. */
+#define REMAP_VERSION       1
+#define REMAP_START         (SETTINGS_START + SETTINGS_SLOT * SETTINGS_SLOTS)
+#define REMAP_COPY_SIZE     (4 + NKEY*2 + 2)
+#define REMAP_OVERLAID      0x01    // flags: the copy replaces the layer
+
+/* Bit n set when layer n is overlaid, and then remap_slot[n] is its row
+   of remap_codes */
+extern uint8_t remap_layers;
+extern uint8_t remap_slot[MODES];
+extern Keycode remap_codes[REMAP_SLOTS][NKEY];
+
+// code of key_id in one layer, from the overlay if the layer has one
+static inline Keycode remap_code(uint8_t layer, uint8_t key_id) {
+  if(remap_layers & 1<<layer) return remap_codes[remap_slot[layer]][key_id];
+  return keymap_code(layer, key_id);
+}
+
+// load the overlays saved in EEPROM, before layer_init()
+void remap_load(void);
+
+// USB interrupt: a command arrived, REMAP_REPORT_SIZE bytes
+void remap_request(const uint8_t *report);
+
+// USB interrupt: the reply to the last command that has run
+void remap_reply(uint8_t *report);
+
+// main loop: run a waiting command, and save changed layers a byte at a
+// time when the EEPROM is free
+void remap_task(void);
+#endif
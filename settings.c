@@ -0,0 +1,157 @@
+/* EEPROM settings journal for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "settings.h"
+#include "hal.h"
+#include "layer.h"
+#include "led.h"
+#include "debug.h"
+
+#define RECORD_SIZE     (3 + sizeof(Settings) + 2)
+#define DELAY_TICKS     ((uint32_t)SETTINGS_DELAY_MS * 1000 * HAL_TIMER_MHZ)
+
+#if SETTINGS_START + SETTINGS_SLOT * SETTINGS_SLOTS > HAL_EEPROM_SIZE
+#error "settings journal does not fit in the EEPROM"
+#endif
+
+// a compile error here means Settings no longer fits in SETTINGS_SLOT
+typedef char settings_fit[RECORD_SIZE <= SETTINGS_SLOT ? 1 : -1];
+
+/* Journal position: the slot and sequence number of the newest record,
+   so the next goes in the slot after it with the next number */
+static uint8_t newest_slot = SETTINGS_SLOTS - 1;
+static uint16_t newest_seq = 0;
+
+/* Save state.  pending is set by settings_changed() and waits out the
+   delay, measured by adding up hal_timer_now() steps, which the main loop
+   takes far more often than the timer wraps.  The record being written is
+   built in record[] all at once and copied out byte by byte. */
+static bool pending = false;
+static uint16_t last_now;
+static uint32_t waited;
+static uint8_t record[RECORD_SIZE];
+static uint8_t written = RECORD_SIZE;
+
+static inline uint16_t slot_addr(uint8_t slot) {
+  return SETTINGS_START + (uint16_t)slot * SETTINGS_SLOT;
+}
+
+static bool slot_valid(uint8_t slot) {
+  uint16_t addr = slot_addr(slot), crc = 0xFFFF;
+  uint8_t i;
+  for(i=0; i<RECORD_SIZE-2; i++) crc = crc16_update(crc, hal_eeprom_read(addr + i));
+  return hal_eeprom_read(addr + i) == (uint8_t)crc
+      && hal_eeprom_read(addr + i + 1) == crc >> 8;
+}
+
+/* Only the version and sequence number of each slot are read to find the
+   newest record, and only that record is CRC checked.  A bad one is
+   skipped and the search repeated, which takes a failed write to happen. */
+void settings_load(void) {
+  uint8_t rejected[(SETTINGS_SLOTS+7)/8] = {0};
+  uint8_t slot, best;
+  uint16_t addr, seq;
+  Settings s;
+  uint8_t *p = (uint8_t *)&s;
+
+  for(;;) {
+    best = 0xFF;
+    for(slot=0; slot<SETTINGS_SLOTS; slot++) {
+      if(rejected[slot>>3] & 1<<(slot&7)) continue;
+      addr = slot_addr(slot);
+      if(hal_eeprom_read(addr) != SETTINGS_VERSION) continue;
+      seq = hal_eeprom_read(addr + 1) | hal_eeprom_read(addr + 2) << 8;
+      if(best == 0xFF || (int16_t)(seq - newest_seq) > 0) {
+        best = slot;
+        newest_seq = seq;
+      }
+    }
+    if(best == 0xFF) {
+      debug_log1(LOG_SETTINGS, 0);
+      return;
+    }
+    if(slot_valid(best)) break;
+    rejected[best>>3] |= 1<<(best&7);
+  }
+  newest_slot = best;
+  addr = slot_addr(best) + 3;
+  for(uint8_t i=0; i<sizeof(Settings); i++) p[i] = hal_eeprom_read(addr + i);
+
+  if(s.layer_default < MODES) {
+    layer_default = s.layer_default;
+    layer_update();
+  }
+  for(uint8_t i=0; i<MODES; i++) {
+    led_layers[i].color = s.led_color[i];
+    led_layers[i].color2 = s.led_color2[i];
+  }
+  debug_log1(LOG_SETTINGS, newest_seq);
+}
+
+void settings_changed(void) {
+  pending = true;
+  waited = 0;
+  last_now = hal_timer_now();
+}
+
+// snapshot the live settings into the next record
+static void settings_build(void) {
+  Settings s;
+  uint8_t *p = (uint8_t *)&s;
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  s.layer_default = layer_default;
+  for(i=0; i<MODES; i++) {
+    s.led_color[i] = led_layers[i].color;
+    s.led_color2[i] = led_layers[i].color2;
+  }
+  newest_seq++;
+  if(++newest_slot == SETTINGS_SLOTS) newest_slot = 0;
+  record[0] = SETTINGS_VERSION;
+  record[1] = newest_seq;
+  record[2] = newest_seq >> 8;
+  for(i=0; i<sizeof(Settings); i++) record[3+i] = p[i];
+  for(i=0; i<RECORD_SIZE-2; i++) crc = crc16_update(crc, record[i]);
+  record[i] = crc;
+  record[i+1] = crc >> 8;
+  written = 0;
+}
+
+void settings_task(void) {
+  uint16_t now;
+
+  if(written < RECORD_SIZE) {
+    if(!hal_eeprom_ready()) return;
+    hal_eeprom_write(slot_addr(newest_slot) + written, record[written]);
+    written++;
+    return;
+  }
+  if(!pending) return;
+  now = hal_timer_now();
+  waited += (uint16_t)(now - last_now);
+  last_now = now;
+  if(waited < DELAY_TICKS) return;
+  pending = false;
+  settings_build();
+}
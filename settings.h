@@ -0,0 +1,41 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Settings kept in EEPROM across power cycles: the default layer and the
+// main LED colours of every layer.
+//
+// Each save is a new record in a journal of SETTINGS_SLOTS fixed size
+// slots, written round robin so every slot wears equally.  A record is a
+// version byte, a 16 bit sequence number, the Settings and a CRC-16 over
+// all of it.  At boot the newest record that checks out is loaded; one cut
+// short by a power loss fails its CRC and the one before it is used.
+// Changes are saved SETTINGS_DELAY_MS after the last of them, as one
+// record, written a byte at a time from the main loop without waiting.
+
+#ifndef __SETTINGS__
+#define __SETTINGS__
+
+#include <stdint.h>
+#include "config.h"
+#include "util.h"
+
+#define SETTINGS_VERSION    1           // bump when Settings changes
+#define SETTINGS_START      0           // journal's first EEPROM address
+#define SETTINGS_SLOT       32          // bytes a record takes
+#define SETTINGS_SLOTS      64
+#define SETTINGS_DELAY_MS   5000
+
+typedef struct {
+  uint8_t layer_default;
+  Hsv led_color[MODES];
+  Hsv led_color2[MODES];
+} Settings;
+
+// apply the newest valid record, or leave the defaults if there is none
+void settings_load(void);
+
+// note that a setting changed, it is saved once they stop changing
+void settings_changed(void);
+
+// main loop: start the save once it is due, then write it out
+void settings_task(void);
+#endif
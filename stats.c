@@ -0,0 +1,123 @@
+/* Pipeline timing statistics for the Virulent Keyboard
+ * Copyright (c) 2013 John Fonte
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notices and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "stats.h"
+#include "hal.h"
+
+typedef struct {
+  uint16_t count;
+  uint16_t min;
+  uint16_t max;
+  uint16_t bucket[STATS_BUCKETS];
+} Histogram;
+
+static Histogram stats[STATS_COUNT];
+uint16_t stats_edge;
+
+// 0-3 map to themselves, above that four buckets per power of two
+static uint8_t stats_bucket(uint16_t ticks) {
+  uint8_t msb = 15;
+  if(ticks < 4) return ticks;
+  while(!(ticks & 0x8000)) {
+    ticks <<= 1;
+    msb--;
+  }
+  return 4*(msb-1) + ((ticks >> 13) & 3);
+}
+
+// largest value that lands in a bucket
+static uint16_t stats_bucket_top(uint8_t b) {
+  uint8_t shift;
+  if(b < 4) return b;
+  shift = b/4 - 1;
+  return ((uint32_t)(4 + b%4 + 1) << shift) - 1;
+}
+
+void stats_reset(void) {
+  uint8_t h, b, intr_state = hal_irq_save();
+  for(h=0; h<STATS_COUNT; h++) {
+    stats[h].count = 0;
+    stats[h].min = 0xFFFF;
+    stats[h].max = 0;
+    for(b=0; b<STATS_BUCKETS; b++) stats[h].bucket[b] = 0;
+  }
+  hal_irq_restore(intr_state);
+}
+
+/* When the count would overflow every bucket is halved, which keeps the
+   shape of the distribution and lets old samples fade out.  The count is
+   the sum of the buckets, so no bucket can overflow before it does. */
+void stats_record(uint8_t hist, uint16_t ticks) {
+  Histogram *s = &stats[hist];
+  uint8_t b = stats_bucket(ticks), i, intr_state = hal_irq_save();
+
+  if(s->count == 0xFFFF) {
+    s->count = 0;
+    for(i=0; i<STATS_BUCKETS; i++) {
+      s->bucket[i] >>= 1;
+      s->count += s->bucket[i];
+    }
+  }
+  s->bucket[b]++;
+  s->count++;
+  if(ticks < s->min) s->min = ticks;
+  if(ticks > s->max) s->max = ticks;
+  hal_irq_restore(intr_state);
+}
+
+// top of the bucket holding the pct-th percentile, clamped to max
+static uint16_t stats_percentile(const Histogram *s, uint8_t pct) {
+  uint32_t want = ((uint32_t)s->count * pct + 99) / 100, seen = 0;
+  uint16_t top;
+  uint8_t b;
+
+  if(s->count == 0) return 0;
+  for(b=0; b<STATS_BUCKETS; b++) {
+    seen += s->bucket[b];
+    if(seen >= want) break;
+  }
+  top = stats_bucket_top(b);
+  return top < s->max ? top : s->max;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+  *p++ = v;
+  *p++ = v >> 8;
+  return p;
+}
+
+void stats_report(uint8_t *report) {
+  uint8_t h, intr_state = hal_irq_save();
+  Histogram *s;
+
+  *report++ = STATS_COUNT;
+  *report++ = HAL_TIMER_MHZ;
+  for(h=0; h<STATS_COUNT; h++) {
+    s = &stats[h];
+    report = put16(report, s->count);
+    report = put16(report, s->count ? s->min : 0);
+    report = put16(report, s->max);
+    report = put16(report, stats_percentile(s, 50));
+    report = put16(report, stats_percentile(s, 99));
+  }
+  hal_irq_restore(intr_state);
+}
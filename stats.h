@@ -0,0 +1,37 @@
+// Author: John Fonte
+// Copyright (c) 2013
+// Timing histograms of the scan and report pipeline, in hal_timer_now()
+// ticks.  Read and reset over the debug interface's feature report, see
+// tools/stats.py.
+
+#ifndef __STATS__
+#define __STATS__
+
+#include <stdint.h>
+
+#define STATS_SCAN      0       // matrix_sample(), inside the scan interrupt
+#define STATS_PASS      1       // a matrix_task() pass over a snapshot
+#define STATS_QUEUE     2       // report queued until armed in the endpoint
+#define STATS_LATENCY   3       // sample that saw the change until armed
+#define STATS_COUNT     4
+
+/* Buckets are log-linear, four to each power of two, so every bucket is
+   within 25% of the values in it from 4 ticks up to 65535 */
+#define STATS_BUCKETS   60
+
+/* Feature report: histogram count, ticks per microsecond, then for each
+   histogram its sample count, min, max, p50 and p99, 16 bit little endian.
+   The percentiles are the top of the bucket they fall in. */
+#define STATS_REPORT_SIZE (2 + STATS_COUNT*10)
+
+/* Commands, the first byte of a feature report written to the device */
+#define STATS_CMD_RESET 1
+
+/* hal_timer_now() of the first sample in the snapshot the report being
+   built came from, carried along with it to time STATS_LATENCY */
+extern uint16_t stats_edge;
+
+void stats_reset(void);
+void stats_record(uint8_t hist, uint16_t ticks);
+void stats_report(uint8_t *report);
+#endif
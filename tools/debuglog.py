@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# Author: John Fonte
+# Copyright (c) 2013
+#
+# Decode the binary log records the firmware writes to its debug interface.
+#
+#   python3 tools/debuglog.py /dev/hidrawN     # live, from the keyboard
+#   python3 tools/debuglog.py log.bin          # a saved stream (bench -d)
+#
+# Record ids and formats are read from debug.h, see the comment there for
+# the record layout.
+
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEBUG_H = os.path.join(HERE, '..', 'debug.h')
+
+
+def formats():
+    table = {}
+    with open(DEBUG_H) as f:
+        for m in re.finditer(r'^#define\s+LOG_\w+\s+(\d+)\s*//\s*"(.*)"',
+                             f.read(), re.M):
+            table[int(m.group(1))] = m.group(2)
+    if not table:
+        sys.exit('%s: no LOG_ ids' % DEBUG_H)
+    return table
+
+
+class Decoder:
+    def __init__(self, table):
+        self.table = table
+        self.pending = b''
+
+    def feed(self, data):
+        """Decode what data completes, keep a trailing partial record."""
+        buf = self.pending + data
+        lines, i = [], 0
+        while i < len(buf):
+            head = buf[i]
+            if head == 0:           # padding after the last record of a packet
+                i += 1
+                continue
+            n = head & 3
+            if i + 1 + 2 * n > len(buf):
+                break
+            args = tuple(buf[i + 1 + 2 * k] | buf[i + 2 + 2 * k] << 8
+                         for k in range(n))
+            lines.append(self.format(head >> 2, args))
+            i += 1 + 2 * n
+        self.pending = buf[i:]
+        return lines
+
+    def format(self, id, args):
+        fmt = self.table.get(id)
+        if fmt is None:
+            return 'unknown record %d %s' % (id, ' '.join('%d' % a for a in args))
+        # %d arguments are signed 16 bit
+        args = list(args)
+        for k, conv in enumerate(re.findall(r'%[-0-9]*([a-z])', fmt)[:len(args)]):
+            if conv == 'd' and args[k] >= 0x8000:
+                args[k] -= 0x10000
+        try:
+            return fmt % tuple(args)
+        except TypeError:
+            return '%s [bad arguments %r]' % (fmt, args)
+
+
+def main(argv):
+    if len(argv) > 2:
+        sys.exit('usage: %s [/dev/hidrawN | file]' % argv[0])
+    decoder = Decoder(formats())
+    fd = os.open(argv[1], os.O_RDONLY) if len(argv) == 2 else sys.stdin.fileno()
+    try:
+        while True:
+            # a hidraw read returns one 32 byte packet, a file whatever fits
+            data = os.read(fd, 4096)
+            if not data:
+                break
+            for line in decoder.feed(data):
+                print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    if decoder.pending:
+        print('truncated record at end of stream', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+# Author: John Fonte
+# Copyright (c) 2013
+#
+# Compile keymap.txt into keymap.c.
+#
+#   python3 tools/keymapgen.py keymap.txt > keymap.c
+#
+# Every layer is stored either dense, one code per key_id, or sparse, as a
+# presence bitmap over key_ids plus the codes of the keys present.  The
+# smaller encoding wins, so mostly empty layers (the 50-key ones) cost a
+# fraction of a full NKEY table.  See keymap_code() in keymap.h.
+#
+# The "macro" lines become the flash macros, as step strings, see macro.h.
+
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CONFIG = os.path.join(HERE, '..', 'config.h')
+
+
+def config(name):
+    with open(CONFIG) as f:
+        m = re.search(r'^#define\s+%s\s+(\d+)' % name, f.read(), re.M)
+    if not m:
+        sys.exit('%s: no %s' % (CONFIG, name))
+    return int(m.group(1))
+
+
+NROW = config('NROW')
+NCOL = config('NCOL')
+NKEY = config('NKEY')
+MODES = config('MODES')
+KEYMAP_BYTES = (NKEY + 7) // 8
+
+
+def fail(path, lineno, msg):
+    sys.exit('%s:%d: %s' % (path, lineno, msg))
+
+
+USAGE = r'KEY_\w+'
+KEY = re.compile(r'NA|TRNS|LED_(HUI|HUD|SAI|SAD|VAI|VAD)|%s'
+                 r'|S\(%s\)|MODS\(KEY_\w+(\|KEY_\w+)*,%s\)'
+                 r'|(MO|TG|OSL|DF)\((\d+)\)|(E?MACRO)\((\d+)\)'
+                 % (USAGE, USAGE, USAGE))
+EMACROS = 128
+
+
+def check_key(path, lineno, key, macro_refs):
+    m = KEY.fullmatch(key)
+    if not m:
+        fail(path, lineno, 'unknown key name %s' % key)
+    if m.group(4) and int(m.group(4)) >= MODES:
+        fail(path, lineno, '%s: no layer %s' % (key, m.group(4)))
+    if m.group(5) == 'EMACRO' and int(m.group(6)) >= EMACROS:
+        fail(path, lineno, '%s: EEPROM macros go up to %d' % (key, EMACROS - 1))
+    if m.group(5) == 'MACRO':
+        macro_refs.append((lineno, key, int(m.group(6))))
+
+
+# A macro line is steps separated by spaces: KEY_x taps a key, +KEY_x
+# presses and -KEY_x releases it, Nms waits N milliseconds and "text" types
+# the text, with \n, \t, \" and \\ escapes.
+STEP = re.compile(r'"((?:[^"\\]|\\.)*)"|([+-]?)(%s)|(\d+)ms' % USAGE)
+ESCAPES = {'n': '\n', 't': '\t', '"': '"', '\\': '\\'}
+WAIT_MAX = 255
+
+
+def macro_steps(text):
+    """The steps of a macro line as (op, argument) pairs, op None for a
+    character to type.  Raises ValueError."""
+    steps = []
+    pos = 0
+    while True:
+        while pos < len(text) and text[pos].isspace():
+            pos += 1
+        if pos == len(text) or text[pos] == '#':
+            break
+        m = STEP.match(text, pos)
+        if not m or (m.end() < len(text) and not text[m.end()].isspace()):
+            raise ValueError('bad macro step %s' % text[pos:].split()[0])
+        pos = m.end()
+        if m.group(3):
+            op = {'+': 'MACRO_DOWN', '-': 'MACRO_UP', '': 'MACRO_TAP'}[m.group(2)]
+            steps.append((op, m.group(3)))
+        elif m.group(4):
+            ms = int(m.group(4))
+            while ms:
+                steps.append(('MACRO_WAIT', min(ms, WAIT_MAX)))
+                ms -= min(ms, WAIT_MAX)
+        else:
+            chars = re.sub(r'\\(.)', lambda e: ESCAPES.get(e.group(1), '\0'),
+                           m.group(1))
+            for c in chars:
+                if c not in '\n\t' and not ' ' <= c <= '~':
+                    raise ValueError('cannot type %r' % c)
+                steps.append((None, c))
+    return steps
+
+
+def c_char(c):
+    return {'\n': "'\\n'", '\t': "'\\t'", "'": "'\\''", '\\': "'\\\\'"}.get(c, "'%s'" % c)
+
+
+def parse(path):
+    layers = []
+    macros = []
+    macro_refs = []
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            if line.startswith('macro '):
+                try:
+                    macros.append(macro_steps(line[6:]))
+                except ValueError as e:
+                    fail(path, lineno, str(e))
+                continue
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if line.startswith('layer '):
+                layers.append((line[6:].strip(), []))
+                continue
+            if not layers:
+                fail(path, lineno, 'keys before the first layer')
+            keys = line.split()
+            if len(keys) != NROW:
+                fail(path, lineno, 'expected %d keys, got %d' % (NROW, len(keys)))
+            for key in keys:
+                check_key(path, lineno, key, macro_refs)
+            columns = layers[-1][1]
+            if len(columns) == NCOL:
+                fail(path, lineno, 'more than %d columns' % NCOL)
+            columns.append(keys)
+    for name, columns in layers:
+        if len(columns) != NCOL:
+            sys.exit('%s: layer "%s" has %d columns, expected %d'
+                     % (path, name, len(columns), NCOL))
+    if len(layers) != MODES:
+        sys.exit('%s: %d layers, config.h has MODES %d'
+                 % (path, len(layers), MODES))
+    for lineno, key, n in macro_refs:
+        if n >= len(macros):
+            fail(path, lineno, '%s: no macro %d' % (key, n))
+    if len(macros) >= EMACROS:
+        sys.exit('%s: more than %d macros' % (path, EMACROS - 1))
+    return layers, macros
+
+
+def bytes_row(values):
+    return ', '.join('0x%02X' % v for v in values)
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.exit('usage: %s keymap.txt > keymap.c' % argv[0])
+    layers, macros = parse(argv[1])
+
+    table = []          # (name, offset, sparse row or None, code count)
+    codes = []          # (layer name, column, [keys])
+    present_rows = []
+    rank_rows = []
+    offset = 0
+    for name, columns in layers:
+        keys = [k for column in columns for k in column]
+        used = sum(k != 'NA' for k in keys)
+        if 2 * KEYMAP_BYTES + used < NKEY:
+            present = [0] * KEYMAP_BYTES
+            for key_id, key in enumerate(keys):
+                if key != 'NA':
+                    present[key_id >> 3] |= 1 << (key_id & 7)
+            # layers with the same holes share one bitmap and rank row
+            if present not in present_rows:
+                rank, total = [], 0
+                for b in present:
+                    rank.append(total)
+                    total += bin(b).count('1')
+                present_rows.append(present)
+                rank_rows.append(rank)
+            table.append((name, offset, present_rows.index(present), used))
+            for col, column in enumerate(columns):
+                codes.append((name, col, [k for k in column if k != 'NA']))
+            offset += used
+        else:
+            table.append((name, offset, None, NKEY))
+            for col, column in enumerate(columns):
+                codes.append((name, col, column))
+            offset += NKEY
+
+    out = sys.stdout
+    out.write('/* Generated by tools/keymapgen.py from %s, do not edit. */\n\n'
+              % os.path.basename(argv[1]))
+    out.write('#include "usb_keyboard.h"\n#include "keymap.h"\n#include "macro.h"\n\n')
+    out.write('#if NKEY != %d || MODES != %d\n' % (NKEY, MODES))
+    out.write('#error "keymap.c is out of date, run make keymap"\n#endif\n\n')
+
+    out.write('const KeymapLayer PROGMEM keymap_layers[MODES] = {\n')
+    for name, off, sparse, size in table:
+        row = 'KEYMAP_DENSE' if sparse is None else '%d' % sparse
+        out.write('  {%5d, %12s },  // %s, %d codes\n' % (off, row, name, size))
+    out.write('};\n\n')
+
+    # keep the arrays non-empty when every layer is dense
+    if not present_rows:
+        present_rows, rank_rows = [[0] * KEYMAP_BYTES], [[0] * KEYMAP_BYTES]
+    out.write('const uint8_t PROGMEM keymap_present[][KEYMAP_BYTES] = {\n')
+    out.write(',\n'.join('  { %s }' % bytes_row(r) for r in present_rows))
+    out.write('\n};\n\n')
+    out.write('const uint8_t PROGMEM keymap_rank[][KEYMAP_BYTES] = {\n')
+    out.write(',\n'.join('  { %s }' % bytes_row(r) for r in rank_rows))
+    out.write('\n};\n\n')
+
+    out.write('const uint8_t PROGMEM keymap_popcount[16] = {\n')
+    out.write('  %s\n};\n\n' % ', '.join(str(bin(i).count('1')) for i in range(16)))
+
+    out.write('const Keycode PROGMEM keymap_codes[%d] = {\n' % offset)
+    last = None
+    for name, col, keys in codes:
+        if name != last:
+            out.write('  // %s\n' % name)
+            last = name
+        if not keys:
+            continue
+        out.write('  %s// COL %2d\n' % (''.join((k + ',').ljust(17) for k in keys), col))
+    out.write('};\n\n')
+
+    # keep the arrays non-empty when there are no macros
+    out.write('const uint8_t PROGMEM macro_steps[] = {\n')
+    index, offset = [], 0
+    for n, steps in enumerate(macros):
+        items = []
+        for op, arg in steps:
+            items += [op, str(arg)] if op else [c_char(arg)]
+        items.append('MACRO_END')
+        out.write('  // macro %d\n' % n)
+        for i in range(0, len(items), 8):
+            out.write('  %s\n' % ' '.join(x + ',' for x in items[i:i + 8]))
+        index.append(offset)
+        offset += len(items)
+    if not macros:
+        out.write('  MACRO_END\n')
+    out.write('};\n\n')
+    out.write('const uint16_t PROGMEM macro_index[] = { %s };\n'
+              % (', '.join(str(i) for i in index) or '0'))
+    out.write('const uint8_t macro_count = %d;\n' % len(macros))
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,401 @@
+#!/usr/bin/env python3
+# Author: John Fonte
+# Copyright (c) 2013
+#
+# Change the keymap of a running keyboard, see remap.h.
+#
+#   python3 tools/remap.py /dev/hidrawN info
+#   python3 tools/remap.py /dev/hidrawN get LAYER KEY_ID
+#   python3 tools/remap.py /dev/hidrawN set LAYER KEY_ID CODE
+#   python3 tools/remap.py /dev/hidrawN dump LAYER > layer.txt
+#   python3 tools/remap.py /dev/hidrawN load LAYER layer.txt
+#   python3 tools/remap.py /dev/hidrawN reset LAYER|all
+#   python3 tools/remap.py /dev/hidrawN macros macros.txt
+#
+# Use the hidraw node of the remap interface (usage page 0xFF31, usage
+# 0x77).  Codes are written as in keymap.txt (KEY_A, S(KEY_1), MO(3), NA,
+# ...) or as numbers.  dump prints a layer in the keymap.txt format and
+# load takes one back, either a single layer or a whole keymap.txt, of which
+# it uses layer LAYER.  A load is switched to in one step once all of it
+# has arrived.  info tells how many layers can be remapped at once; to
+# remap another, reset one of them first.  macros replaces the EEPROM
+# macros, played with EMACRO(n), with the "macro" lines of a file, written
+# as in keymap.txt.
+#
+# Instead of a device, -m "host/remapdev -e eeprom.bin" runs the mock
+# device from the host build.
+
+import fcntl
+import os
+import re
+import shlex
+import subprocess
+import sys
+import time
+
+from keymapgen import macro_steps
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+USB_KEYBOARD_H = os.path.join(HERE, '..', 'usb_keyboard.h')
+
+REPORT_SIZE = 32
+CMD_INFO, CMD_GET, CMD_SET, CMD_BEGIN, CMD_WRITE, CMD_COMMIT, CMD_READ, \
+    CMD_RESET, CMD_MACROS = range(1, 10)
+STATUS = {1: 'bad command', 2: 'bad argument', 3: 'no upload in progress',
+          4: 'every overlay slot is taken, reset a layer first'}
+TIMEOUT = 2.0
+
+NA, TRNS = 0, 1
+ACTIONS = {0x10: 'MO', 0x11: 'TG', 0x12: 'OSL', 0x13: 'DF'}
+ACTION_LED = 0x14
+ACTION_MACRO = 0x15
+LED = ['LED_HUI', 'LED_HUD', 'LED_SAI', 'LED_SAD', 'LED_VAI', 'LED_VAD']
+MACRO_EEPROM = 0x80
+MACRO_OPS = {'MACRO_DOWN': 1, 'MACRO_UP': 2, 'MACRO_TAP': 3, 'MACRO_WAIT': 4}
+MACRO_END = 0
+MACRO_BYTES = 28
+
+
+def key_names():
+    """Modifier bit names and usage names from usb_keyboard.h."""
+    mods, usages = {}, {}
+    table = mods
+    with open(USB_KEYBOARD_H) as f:
+        for line in f:
+            if line.startswith('#define KEY_RESERVED1'):
+                table = usages
+            m = re.match(r'#define\s+(KEY_\w+)\s+(0x[0-9A-Fa-f]+|\d+)\s*$', line)
+            if m:
+                table[m.group(1)] = int(m.group(2), 0)
+    return mods, usages
+
+
+MOD_NAMES, USAGE_NAMES = key_names()
+USAGE_BY_CODE = {}
+for _name, _code in USAGE_NAMES.items():
+    USAGE_BY_CODE.setdefault(_code, _name)
+MOD_BITS = ['KEY_CTRL', 'KEY_SHIFT', 'KEY_ALT', 'KEY_GUI']
+
+
+def usage_name(usage):
+    return USAGE_BY_CODE.get(usage, '0x%02X' % usage)
+
+
+def code_name(code):
+    if code == NA:
+        return 'NA'
+    if code == TRNS:
+        return 'TRNS'
+    if code >= 0x1000:
+        action, arg = code >> 8, code & 0xFF
+        if action in ACTIONS:
+            return '%s(%d)' % (ACTIONS[action], arg)
+        if action == ACTION_LED and arg < len(LED):
+            return LED[arg]
+        if action == ACTION_MACRO:
+            if arg & MACRO_EEPROM:
+                return 'EMACRO(%d)' % (arg & ~MACRO_EEPROM)
+            return 'MACRO(%d)' % arg
+        return '0x%04X' % code
+    mods, usage = code >> 8, code & 0xFF
+    if not mods:
+        return usage_name(usage)
+    if mods == MOD_NAMES['KEY_SHIFT']:
+        return 'S(%s)' % usage_name(usage)
+    names = [n for i, n in enumerate(MOD_BITS) if mods & 1 << i]
+    if mods >> len(MOD_BITS):
+        return '0x%04X' % code
+    return 'MODS(%s,%s)' % ('|'.join(names), usage_name(usage))
+
+
+def parse_usage(text):
+    if text in USAGE_NAMES:
+        return USAGE_NAMES[text]
+    try:
+        return int(text, 0)
+    except ValueError:
+        raise ValueError('unknown key name %s' % text)
+
+
+def parse_code(text):
+    """A keymap.txt key name or a number, as a Keycode."""
+    try:
+        if text == 'NA':
+            return NA
+        if text == 'TRNS':
+            return TRNS
+        if text in LED:
+            return ACTION_LED << 8 | LED.index(text)
+        m = re.fullmatch(r'(MO|TG|OSL|DF)\((\d+)\)', text)
+        if m:
+            action = [a for a, n in ACTIONS.items() if n == m.group(1)][0]
+            return action << 8 | int(m.group(2))
+        m = re.fullmatch(r'(E?)MACRO\((\d+)\)', text)
+        if m and int(m.group(2)) < MACRO_EEPROM:
+            return ACTION_MACRO << 8 | (MACRO_EEPROM if m.group(1) else 0) | int(m.group(2))
+        m = re.fullmatch(r'S\((\w+)\)', text)
+        if m:
+            return MOD_NAMES['KEY_SHIFT'] << 8 | parse_usage(m.group(1))
+        m = re.fullmatch(r'MODS\((KEY_\w+(?:\|KEY_\w+)*),(\w+)\)', text)
+        if m:
+            mods = 0
+            for name in m.group(1).split('|'):
+                mods |= MOD_NAMES[name]
+            return mods << 8 | parse_usage(m.group(2))
+        code = parse_usage(text)
+    except (KeyError, ValueError):
+        code = -1
+    if not 0 <= code <= 0xFFFF:
+        raise ValueError('unknown key name %s' % text)
+    return code
+
+
+def ioc(nr, size):
+    # _IOC(_IOC_READ|_IOC_WRITE, 'H', nr, size) from linux/hidraw.h
+    return (3 << 30) | (size << 16) | (ord('H') << 8) | nr
+
+
+class Hidraw:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR)
+
+    def set_feature(self, data):
+        # no report ids: byte 0 is report number 0, the report follows it
+        buf = bytearray([0]) + bytearray(data)
+        fcntl.ioctl(self.fd, ioc(0x06, len(buf)), buf)
+
+    def get_feature(self):
+        buf = bytearray(REPORT_SIZE + 1)
+        n = fcntl.ioctl(self.fd, ioc(0x07, len(buf)), buf)
+        return bytes(buf[1:n])
+
+    def close(self):
+        os.close(self.fd)
+
+
+class Mock:
+    """host/remapdev over a pipe, one request a line."""
+
+    def __init__(self, command):
+        self.proc = subprocess.Popen(shlex.split(command), stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, universal_newlines=True)
+
+    def request(self, line):
+        self.proc.stdin.write(line + '\n')
+        self.proc.stdin.flush()
+        reply = self.proc.stdout.readline().strip()
+        if not reply or reply == 'error':
+            sys.exit('mock device: no answer to %s' % line.split()[0])
+        return reply
+
+    def set_feature(self, data):
+        self.request('S ' + bytes(data).hex())
+
+    def get_feature(self):
+        return bytes.fromhex(self.request('G'))
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait()
+
+
+class Remap:
+    def __init__(self, dev):
+        self.dev = dev
+        self.tag = self.dev.get_feature()[1]
+        info = self.command(CMD_INFO)
+        self.nrow, self.ncol, self.nkey, self.modes, self.overlaid, \
+            self.chunk, self.macro_size, self.slots = info[:8]
+
+    def command(self, cmd, *args):
+        """Send one command and wait for its reply, returns the results."""
+        self.tag = self.tag % 255 + 1
+        report = bytes([cmd, self.tag] + list(args))
+        self.dev.set_feature(report + bytes(REPORT_SIZE - len(report)))
+        deadline = time.time() + TIMEOUT
+        while True:
+            reply = self.dev.get_feature()
+            if reply[0] == cmd and reply[1] == self.tag:
+                break
+            if time.time() > deadline:
+                sys.exit('no reply from the keyboard')
+            time.sleep(0.001)
+        if reply[2]:
+            sys.exit('keyboard: %s' % STATUS.get(reply[2], 'error %d' % reply[2]))
+        return reply[3:]
+
+    def check_layer(self, layer):
+        if not 0 <= layer < self.modes:
+            sys.exit('no layer %d, the keyboard has %d' % (layer, self.modes))
+
+    def check_key(self, key_id):
+        if not 0 <= key_id < self.nkey:
+            sys.exit('no key_id %d, the keyboard has %d' % (key_id, self.nkey))
+
+    def get(self, layer, key_id):
+        r = self.command(CMD_GET, layer, key_id)
+        return r[0] | r[1] << 8
+
+    def set(self, layer, key_id, code):
+        self.command(CMD_SET, layer, key_id, code & 0xFF, code >> 8)
+
+    def read_layer(self, layer):
+        codes = []
+        while len(codes) < self.nkey:
+            count = min(self.chunk, self.nkey - len(codes))
+            r = self.command(CMD_READ, layer, len(codes), count)
+            codes += [r[2 + 2 * i] | r[3 + 2 * i] << 8 for i in range(count)]
+        return codes
+
+    def write_layer(self, layer, codes):
+        self.command(CMD_BEGIN, layer)
+        for first in range(0, self.nkey, self.chunk):
+            part = codes[first:first + self.chunk]
+            data = []
+            for code in part:
+                data += [code & 0xFF, code >> 8]
+            self.command(CMD_WRITE, first, len(part), *data)
+        self.command(CMD_COMMIT)
+
+    def reset(self, layer):
+        self.command(CMD_RESET, layer)
+
+    def write_macros(self, data):
+        data = data + bytes(self.macro_size - len(data))
+        for first in range(0, len(data), MACRO_BYTES):
+            part = data[first:first + MACRO_BYTES]
+            self.command(CMD_MACROS, first, len(part), *part)
+
+
+def dump(remap, layer, out):
+    codes = remap.read_layer(layer)
+    names = [code_name(c) for c in codes]
+    out.write('layer %d\n' % layer)
+    for col in range(remap.ncol):
+        keys = names[col * remap.nrow:(col + 1) * remap.nrow]
+        out.write(''.join(k.ljust(17) for k in keys).rstrip() + '\n')
+
+
+def parse_layer(remap, path, layer):
+    """Codes of one layer of a keymap.txt style file."""
+    layers = []
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if line.startswith('layer '):
+                layers.append([])
+                continue
+            if not layers:
+                layers.append([])
+            keys = line.split()
+            if len(keys) != remap.nrow:
+                sys.exit('%s:%d: expected %d keys, got %d'
+                         % (path, lineno, remap.nrow, len(keys)))
+            try:
+                layers[-1] += [parse_code(k) for k in keys]
+            except ValueError as e:
+                sys.exit('%s:%d: %s' % (path, lineno, e))
+    if len(layers) == 1:
+        codes = layers[0]
+    elif layer < len(layers):
+        codes = layers[layer]
+    else:
+        sys.exit('%s: no layer %d' % (path, layer))
+    if len(codes) != remap.nkey:
+        sys.exit('%s: %d keys, the keyboard has %d' % (path, len(codes), remap.nkey))
+    return codes
+
+
+def parse_macros(path):
+    """The EEPROM bytes of the "macro" lines of a file."""
+    data = bytearray()
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            if not line.startswith('macro '):
+                continue
+            try:
+                for op, arg in macro_steps(line[6:]):
+                    if op is None:
+                        data.append(ord(arg))
+                    elif op == 'MACRO_WAIT':
+                        data += bytes([MACRO_OPS[op], arg])
+                    else:
+                        data += bytes([MACRO_OPS[op], parse_usage(arg)])
+            except (KeyError, ValueError) as e:
+                sys.exit('%s:%d: %s' % (path, lineno, e))
+            data.append(MACRO_END)
+    return bytes(data)
+
+
+def usage(argv):
+    sys.exit('usage: %s /dev/hidrawN|-m COMMAND info|get|set|dump|load|reset|macros ...'
+             % argv[0])
+
+
+def main(argv):
+    args = argv[1:]
+    if len(args) >= 2 and args[0] == '-m':
+        dev = Mock(args[1])
+        args = args[2:]
+    elif args:
+        dev = Hidraw(args[0])
+        args = args[1:]
+    else:
+        usage(argv)
+    if not args:
+        usage(argv)
+    cmd, args = args[0], args[1:]
+    try:
+        remap = Remap(dev)
+        if cmd == 'info' and not args:
+            print('%d rows, %d columns, %d keys, %d layers'
+                  % (remap.nrow, remap.ncol, remap.nkey, remap.modes))
+            print('remapped layers: %s' % (' '.join(
+                str(l) for l in range(remap.modes) if remap.overlaid & 1 << l)
+                or 'none'))
+            print('up to %d layers remapped at once' % remap.slots)
+        elif cmd == 'get' and len(args) == 2:
+            layer, key_id = int(args[0]), int(args[1])
+            remap.check_layer(layer)
+            remap.check_key(key_id)
+            print(code_name(remap.get(layer, key_id)))
+        elif cmd == 'set' and len(args) == 3:
+            layer, key_id = int(args[0]), int(args[1])
+            remap.check_layer(layer)
+            remap.check_key(key_id)
+            try:
+                code = parse_code(args[2])
+            except ValueError as e:
+                sys.exit(str(e))
+            remap.set(layer, key_id, code)
+        elif cmd == 'dump' and len(args) == 1:
+            layer = int(args[0])
+            remap.check_layer(layer)
+            dump(remap, layer, sys.stdout)
+        elif cmd == 'load' and len(args) == 2:
+            layer = int(args[0])
+            remap.check_layer(layer)
+            remap.write_layer(layer, parse_layer(remap, args[1], layer))
+        elif cmd == 'macros' and len(args) == 1:
+            data = parse_macros(args[0])
+            if len(data) > remap.macro_size:
+                sys.exit('%s: %d bytes of macros, the keyboard has room for %d'
+                         % (args[0], len(data), remap.macro_size))
+            remap.write_macros(data)
+        elif cmd == 'reset' and len(args) == 1:
+            if args[0] == 'all':
+                remap.reset(0xFF)
+            else:
+                layer = int(args[0])
+                remap.check_layer(layer)
+                remap.reset(layer)
+        else:
+            usage(argv)
+    finally:
+        dev.close()
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Author: John Fonte
+# Copyright (c) 2013
+#
+# Read or reset the timing histograms the firmware keeps in stats.c.
+#
+#   python3 tools/stats.py /dev/hidrawN        # print them
+#   python3 tools/stats.py -r /dev/hidrawN     # reset them
+#
+# Use the hidraw node of the debug interface (usage page 0xFF31).  The
+# layout of the feature report is described in stats.h.
+
+import fcntl
+import os
+import struct
+import sys
+
+NAMES = ['scan', 'pass', 'queue', 'latency']
+STATS_CMD_RESET = 1
+REPORT_MAX = 64
+
+
+def ioc(nr, size):
+    # _IOC(_IOC_READ|_IOC_WRITE, 'H', nr, size) from linux/hidraw.h
+    return (3 << 30) | (size << 16) | (ord('H') << 8) | nr
+
+
+def get_feature(fd):
+    # no report ids: byte 0 is report number 0, the report follows it
+    buf = bytearray(REPORT_MAX + 1)
+    n = fcntl.ioctl(fd, ioc(0x07, len(buf)), buf)
+    return bytes(buf[1:n])
+
+
+def set_feature(fd, data):
+    buf = bytearray([0]) + bytearray(data)
+    fcntl.ioctl(fd, ioc(0x06, len(buf)), buf)
+
+
+def show(report):
+    count, mhz = report[0], report[1]
+    print('%-8s %8s %8s %8s %8s %8s  (us)' % ('', 'count', 'min', 'max', 'p50', 'p99'))
+    for h in range(count):
+        n, lo, hi, p50, p99 = struct.unpack_from('<5H', report, 2 + 10 * h)
+        name = NAMES[h] if h < len(NAMES) else 'hist%d' % h
+        print('%-8s %8d %8.1f %8.1f %8.1f %8.1f'
+              % (name, n, lo / mhz, hi / mhz, p50 / mhz, p99 / mhz))
+
+
+def main(argv):
+    args = argv[1:]
+    reset = '-r' in args
+    args = [a for a in args if a != '-r']
+    if len(args) != 1:
+        sys.exit('usage: %s [-r] /dev/hidrawN' % argv[0])
+    fd = os.open(args[0], os.O_RDWR)
+    try:
+        if reset:
+            report = get_feature(fd)
+            set_feature(fd, [STATS_CMD_RESET] + [0] * (len(report) - 1))
+        else:
+            show(get_feature(fd))
+    finally:
+        os.close(fd)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -25,7 +25,11 @@
 // Version 1.1: Add support for Teensy 2.0
 
 #define USB_SERIAL_PRIVATE_INCLUDE
+#include <stddef.h>
 #include "usb_keyboard.h"
+#include "hal.h"
+#include "stats.h"
+#include "remap.h"
 
 /**************************************************************************
  *
@@ -68,11 +72,32 @@
 #define KEYBOARD_SIZE           8
 #define KEYBOARD_BUFFER         EP_DOUBLE_BUFFER
 
+// The N-key rollover report is a bitmap of usages 0-0xE7 (29 bytes).  Its
+// last byte covers 0xE0-0xE7, which is exactly the modifier byte.
+#define NKRO_INTERFACE          1
+#define NKRO_ENDPOINT           4
+#define NKRO_SIZE               32
+#define NKRO_BUFFER             EP_DOUBLE_BUFFER
+#define NKRO_REPORT_SIZE        (NKRO_KEYS_BYTES+1)
+
+// Debug output, a vendor defined HID interface read with hid_listen
+#define DEBUG_INTERFACE         2
+#define DEBUG_TX_ENDPOINT       1
+#define DEBUG_TX_SIZE           32
+#define DEBUG_TX_BUFFER         EP_DOUBLE_BUFFER
+
+// Keymap changes, a vendor defined HID interface driven by feature reports
+// (see remap.h).  HID needs an interrupt IN endpoint, nothing is sent on it.
+#define REMAP_INTERFACE         3
+#define REMAP_ENDPOINT          2
+#define REMAP_SIZE              8
+#define REMAP_BUFFER            EP_SINGLE_BUFFER
+
 static const uint8_t PROGMEM endpoint_config_table[] = {
-  0,
-  0,
+  1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(DEBUG_TX_SIZE) | DEBUG_TX_BUFFER,
+  1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(REMAP_SIZE) | REMAP_BUFFER,
   1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(KEYBOARD_SIZE) | KEYBOARD_BUFFER,
-  0
+  1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(NKRO_SIZE) | NKRO_BUFFER
 };
 
 
@@ -142,15 +167,67 @@ static uint8_t PROGMEM keyboard_hid_report_desc[] = {
   0xc0                 // End Collection
 };
 
-#define CONFIG1_DESC_SIZE        (9+9+9+7)
+// N-key rollover keyboard, one bit per usage.  Not a boot device, so the
+// BIOS ignores it and keeps using the interface above.
+static uint8_t PROGMEM nkro_hid_report_desc[] = {
+  0x05, 0x01,          // Usage Page (Generic Desktop),
+  0x09, 0x06,          // Usage (Keyboard),
+  0xA1, 0x01,          // Collection (Application),
+  0x75, 0x01,          //   Report Size (1),
+  0x95, NKRO_REPORT_SIZE*8, //   Report Count (232),
+  0x15, 0x00,          //   Logical Minimum (0),
+  0x25, 0x01,          //   Logical Maximum (1),
+  0x05, 0x07,          //   Usage Page (Key Codes),
+  0x19, 0x00,          //   Usage Minimum (0),
+  0x29, 0xE7,          //   Usage Maximum (231),
+  0x81, 0x02,          //   Input (Data, Variable, Absolute),
+  0xc0                 // End Collection
+};
+
+static uint8_t PROGMEM debug_hid_report_desc[] = {
+  0x06, 0x31, 0xFF,    // Usage Page 0xFF31 (vendor defined)
+  0x09, 0x74,          // Usage 0x74
+  0xA1, 0x53,          // Collection 0x53
+  0x75, 0x08,          //   report size = 8 bits
+  0x15, 0x00,          //   logical minimum = 0
+  0x26, 0xFF, 0x00,    //   logical maximum = 255
+  0x95, DEBUG_TX_SIZE, //   report count
+  0x09, 0x75,          //   usage
+  0x81, 0x02,          //   Input (array)
+  0x95, STATS_REPORT_SIZE, //   report count
+  0x09, 0x76,          //   usage
+  0xB1, 0x02,          //   Feature (timing statistics, see stats.h)
+  0xC0                 // end collection
+};
+
+static uint8_t PROGMEM remap_hid_report_desc[] = {
+  0x06, 0x31, 0xFF,    // Usage Page 0xFF31 (vendor defined)
+  0x09, 0x77,          // Usage 0x77
+  0xA1, 0x53,          // Collection 0x53
+  0x75, 0x08,          //   report size = 8 bits
+  0x15, 0x00,          //   logical minimum = 0
+  0x26, 0xFF, 0x00,    //   logical maximum = 255
+  0x95, REMAP_SIZE,    //   report count
+  0x09, 0x78,          //   usage
+  0x81, 0x02,          //   Input (unused)
+  0x95, REMAP_REPORT_SIZE, //   report count
+  0x09, 0x79,          //   usage
+  0xB1, 0x02,          //   Feature (commands and replies, see remap.h)
+  0xC0                 // end collection
+};
+
+#define CONFIG1_DESC_SIZE        (9+9+9+7+9+9+7+9+9+7+9+9+7)
 #define KEYBOARD_HID_DESC_OFFSET (9+9)
+#define NKRO_HID_DESC_OFFSET     (9+9+9+7+9)
+#define DEBUG_HID_DESC_OFFSET    (9+9+9+7+9+9+7+9)
+#define REMAP_HID_DESC_OFFSET    (9+9+9+7+9+9+7+9+9+7+9)
 static uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
   // configuration descriptor, USB spec 9.6.3, page 264-266, Table 9-10
   9,                                      // bLength;
   2,                                      // bDescriptorType;
   LSB(CONFIG1_DESC_SIZE),                 // wTotalLength
   MSB(CONFIG1_DESC_SIZE),
-  1,                                      // bNumInterfaces
+  4,                                      // bNumInterfaces
   1,                                      // bConfigurationValue
   0,                                      // iConfiguration
   0xC0,                                   // bmAttributes
@@ -180,7 +257,85 @@ static uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
   KEYBOARD_ENDPOINT | 0x80,               // bEndpointAddress
   0x03,                                   // bmAttributes (0x03=intr)
   KEYBOARD_SIZE, 0,                       // wMaxPacketSize
-  1                                       // bInterval
+  1,                                      // bInterval
+  // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+  9,                                      // bLength
+  4,                                      // bDescriptorType
+  NKRO_INTERFACE,                         // bInterfaceNumber
+  0,                                      // bAlternateSetting
+  1,                                      // bNumEndpoints
+  0x03,                                   // bInterfaceClass (0x03 = HID)
+  0x00,                                   // bInterfaceSubClass
+  0x00,                                   // bInterfaceProtocol
+  0,                                      // iInterface
+  // HID interface descriptor, HID 1.11 spec, section 6.2.1
+  9,                                      // bLength
+  0x21,                                   // bDescriptorType
+  0x11, 0x01,                             // bcdHID
+  0,                                      // bCountryCode
+  1,                                      // bNumDescriptors
+  0x22,                                   // bDescriptorType
+  sizeof(nkro_hid_report_desc),           // wDescriptorLength
+  0,
+  // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+  7,                                      // bLength
+  5,                                      // bDescriptorType
+  NKRO_ENDPOINT | 0x80,                   // bEndpointAddress
+  0x03,                                   // bmAttributes (0x03=intr)
+  NKRO_SIZE, 0,                           // wMaxPacketSize
+  1,                                      // bInterval
+  // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+  9,                                      // bLength
+  4,                                      // bDescriptorType
+  DEBUG_INTERFACE,                        // bInterfaceNumber
+  0,                                      // bAlternateSetting
+  1,                                      // bNumEndpoints
+  0x03,                                   // bInterfaceClass (0x03 = HID)
+  0x00,                                   // bInterfaceSubClass
+  0x00,                                   // bInterfaceProtocol
+  0,                                      // iInterface
+  // HID interface descriptor, HID 1.11 spec, section 6.2.1
+  9,                                      // bLength
+  0x21,                                   // bDescriptorType
+  0x11, 0x01,                             // bcdHID
+  0,                                      // bCountryCode
+  1,                                      // bNumDescriptors
+  0x22,                                   // bDescriptorType
+  sizeof(debug_hid_report_desc),          // wDescriptorLength
+  0,
+  // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+  7,                                      // bLength
+  5,                                      // bDescriptorType
+  DEBUG_TX_ENDPOINT | 0x80,               // bEndpointAddress
+  0x03,                                   // bmAttributes (0x03=intr)
+  DEBUG_TX_SIZE, 0,                       // wMaxPacketSize
+  1,                                      // bInterval
+  // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+  9,                                      // bLength
+  4,                                      // bDescriptorType
+  REMAP_INTERFACE,                        // bInterfaceNumber
+  0,                                      // bAlternateSetting
+  1,                                      // bNumEndpoints
+  0x03,                                   // bInterfaceClass (0x03 = HID)
+  0x00,                                   // bInterfaceSubClass
+  0x00,                                   // bInterfaceProtocol
+  0,                                      // iInterface
+  // HID interface descriptor, HID 1.11 spec, section 6.2.1
+  9,                                      // bLength
+  0x21,                                   // bDescriptorType
+  0x11, 0x01,                             // bcdHID
+  0,                                      // bCountryCode
+  1,                                      // bNumDescriptors
+  0x22,                                   // bDescriptorType
+  sizeof(remap_hid_report_desc),          // wDescriptorLength
+  0,
+  // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+  7,                                      // bLength
+  5,                                      // bDescriptorType
+  REMAP_ENDPOINT | 0x80,                  // bEndpointAddress
+  0x03,                                   // bmAttributes (0x03=intr)
+  REMAP_SIZE, 0,                          // wMaxPacketSize
+  10                                      // bInterval
 };
 
 // If you're desperate for a little extra code memory, these strings
@@ -219,6 +374,12 @@ static struct descriptor_list_struct {
   {0x0200, 0x0000, config1_descriptor, sizeof(config1_descriptor)},
   {0x2200, KEYBOARD_INTERFACE, keyboard_hid_report_desc, sizeof(keyboard_hid_report_desc)},
   {0x2100, KEYBOARD_INTERFACE, config1_descriptor+KEYBOARD_HID_DESC_OFFSET, 9},
+  {0x2200, NKRO_INTERFACE, nkro_hid_report_desc, sizeof(nkro_hid_report_desc)},
+  {0x2100, NKRO_INTERFACE, config1_descriptor+NKRO_HID_DESC_OFFSET, 9},
+  {0x2200, DEBUG_INTERFACE, debug_hid_report_desc, sizeof(debug_hid_report_desc)},
+  {0x2100, DEBUG_INTERFACE, config1_descriptor+DEBUG_HID_DESC_OFFSET, 9},
+  {0x2200, REMAP_INTERFACE, remap_hid_report_desc, sizeof(remap_hid_report_desc)},
+  {0x2100, REMAP_INTERFACE, config1_descriptor+REMAP_HID_DESC_OFFSET, 9},
   {0x0300, 0x0000, (const uint8_t *)&string0, 4},
   {0x0301, 0x0409, (const uint8_t *)&string1, sizeof(STR_MANUFACTURER)},
   {0x0302, 0x0409, (const uint8_t *)&string2, sizeof(STR_PRODUCT)}
@@ -243,14 +404,19 @@ uint8_t keyboard_modifier_keys=0;
 // which keys are currently pressed, up to 6 keys may be down at once
 uint8_t keyboard_keys[6]={0,0,0,0,0,0};
 
-// protocol setting from the host.  We use exactly the same report
-// either way, so this variable only stores the setting since we
-// are required to be able to report which setting is in use.
+// every pressed key, bit n of byte n/8 for usage n (0-0xDF)
+uint8_t keyboard_nkro[NKRO_KEYS_BYTES];
+
+// protocol setting from the host, 0=boot, 1=report.  With the report
+// protocol the keys go out as an NKRO bitmap on NKRO_ENDPOINT and the
+// boot interface stays silent; a BIOS selects the boot protocol and gets
+// the 6 key report on KEYBOARD_ENDPOINT instead.
 static uint8_t keyboard_protocol=1;
 
 // the idle configuration, how often we send the report to the
 // host (ms * 4) even when it hasn't changed
 static uint8_t keyboard_idle_config=125;
+static uint8_t nkro_idle_config=125;
 
 // count until idle timeout
 static uint8_t keyboard_idle_count=0;
@@ -258,6 +424,85 @@ static uint8_t keyboard_idle_count=0;
 // 1=num lock, 2=caps lock, 4=scroll lock, 8=compose, 16=kana
 volatile uint8_t keyboard_leds=0;
 
+// the time remaining before we transmit any partially full
+// debug packet
+static volatile uint8_t debug_flush_timer=0;
+
+// debug output waiting for the endpoint.  Writers copy into it with
+// interrupts off, so it may be written from the main loop and interrupts
+// alike, and the start of frame interrupt drains it.  The indexes wrap
+// with the byte, 255 bytes fit.
+static uint8_t debug_ring[256];
+static volatile uint8_t debug_head=0;
+static volatile uint8_t debug_tail=0;
+
+// reports waiting for the endpoint.  usb_keyboard_send() is the only
+// writer of report_head and usb_keyboard_drain(), which runs with
+// interrupts off, the only writer of report_tail, so the main loop never
+// waits on the USB.  The slot before report_head holds the last report
+// handed over, which is what the idle timeout repeats.
+#define REPORT_RING             8       // power of 2
+static struct {
+  uint8_t endpoint;
+  uint16_t queued;                      // hal_timer_now() stamps for
+  uint16_t edge;                        // STATS_QUEUE and STATS_LATENCY
+  uint8_t data[NKRO_REPORT_SIZE];
+} report_ring[REPORT_RING];
+static volatile uint8_t report_head=0;
+static volatile uint8_t report_tail=0;
+
+// move buffered debug output into the endpoint in DEBUG_TX_SIZE packets.
+// A partly filled packet, padded with zeros, only goes out when partial
+// is set.  Call with interrupts off.
+static void usb_debug_drain(uint8_t partial)
+{
+  uint8_t i, n, tail = debug_tail;
+
+  UENUM = DEBUG_TX_ENDPOINT;
+  while (tail != debug_head && (UEINTX & (1<<RWAL))) {
+    n = debug_head - tail;
+    if (n < DEBUG_TX_SIZE && !partial) break;
+    for (i=0; i<DEBUG_TX_SIZE; i++) {
+      UEDATX = i < n ? debug_ring[tail++] : 0;
+    }
+    UEINTX = 0x3A;
+  }
+  debug_tail = tail;
+}
+
+// write one report into its endpoint
+static inline void usb_keyboard_write(uint8_t slot)
+{
+  uint8_t i, n;
+
+  UENUM = report_ring[slot].endpoint;
+  n = report_ring[slot].endpoint == NKRO_ENDPOINT ? NKRO_REPORT_SIZE : KEYBOARD_SIZE;
+  for (i=0; i<n; i++) {
+    UEDATX = report_ring[slot].data[i];
+  }
+  UEINTX = 0x3A;
+}
+
+// move queued reports into the double buffered endpoints, in order,
+// for as long as they have a free bank.  Call with interrupts off.
+static void usb_keyboard_drain(void)
+{
+  uint8_t tail = report_tail;
+  uint16_t now;
+
+  while (tail != report_head) {
+    UENUM = report_ring[tail].endpoint;
+    if (!(UEINTX & (1<<RWAL))) break;
+    usb_keyboard_write(tail);
+    now = hal_timer_now();
+    stats_record(STATS_QUEUE, now - report_ring[tail].queued);
+    stats_record(STATS_LATENCY, now - report_ring[tail].edge);
+    tail = (tail + 1) & (REPORT_RING-1);
+    keyboard_idle_count = 0;
+  }
+  report_tail = tail;
+}
+
 
 /**************************************************************************
  *
@@ -288,54 +533,95 @@ uint8_t usb_configured(void)
 }
 
 
-// perform a single keystroke
-int8_t usb_keyboard_press(uint8_t key, uint8_t modifier)
+// the frame number of the last start of frame, which the host sends
+// every millisecond
+uint8_t usb_frame(void)
 {
-  int8_t r;
-
-  keyboard_modifier_keys = modifier;
-  keyboard_keys[0] = key;
-  r = usb_keyboard_send();
-  if (r) return r;
-  keyboard_modifier_keys = 0;
-  keyboard_keys[0] = 0;
-  return usb_keyboard_send();
+  return UDFNUML;
 }
 
-// send the contents of keyboard_keys and keyboard_modifier_keys
+// send the pressed keys, as keyboard_nkro and keyboard_modifier_keys
+// on the NKRO interface or as keyboard_keys on the boot interface,
+// depending on the protocol the host selected.  The report is queued
+// and this returns at once; the start of frame interrupt sends whatever
+// the endpoint could not take yet.  Returns -1 without queueing when the
+// USB is not configured or REPORT_RING reports are already waiting, the
+// caller should send the same report again later.
 int8_t usb_keyboard_send(void)
 {
-  uint8_t i, intr_state, timeout;
+  uint8_t i, intr_state, head, next, *data;
 
   if (!usb_configuration) return -1;
+  head = report_head;
+  next = (head + 1) & (REPORT_RING-1);
+  if (next == report_tail) return -1;
+  data = report_ring[head].data;
+  if (keyboard_protocol) {
+    for (i=0; i<NKRO_KEYS_BYTES; i++) {
+      data[i] = keyboard_nkro[i];
+    }
+    data[NKRO_KEYS_BYTES] = keyboard_modifier_keys;
+    report_ring[head].endpoint = NKRO_ENDPOINT;
+  } else {
+    data[0] = keyboard_modifier_keys;
+    data[1] = 0;
+    for (i=0; i<6; i++) {
+      data[i+2] = keyboard_keys[i];
+    }
+    report_ring[head].endpoint = KEYBOARD_ENDPOINT;
+  }
+  report_ring[head].edge = stats_edge;
+  report_ring[head].queued = hal_timer_now();
+  // the slot must be complete before the interrupt can see it
+  __asm__ __volatile__ ("" ::: "memory");
+  report_head = next;
+  // usually the endpoint has a free bank, don't wait for the next frame
   intr_state = SREG;
   cli();
-  UENUM = KEYBOARD_ENDPOINT;
-  timeout = UDFNUML + 50;
-  while (1) {
-    // are we ready to transmit?
-    if (UEINTX & (1<<RWAL)) break;
+  usb_keyboard_drain();
+  SREG = intr_state;
+  return 0;
+}
+
+// queue len bytes for the debug interface, all of them or none.  Never
+// waits: 0 returned on success, -1 if the buffer is too full.
+int8_t usb_debug_write(const uint8_t *data, uint8_t len)
+{
+  uint8_t intr_state, head;
+
+  intr_state = SREG;
+  cli();
+  head = debug_head;
+  if ((uint8_t)(debug_tail - head - 1) < len) {
     SREG = intr_state;
-    // has the USB gone offline?
-    if (!usb_configuration) return -1;
-    // have we waited too long?
-    if (UDFNUML == timeout) return -1;
-    // get ready to try checking again
-    intr_state = SREG;
-    cli();
-    UENUM = KEYBOARD_ENDPOINT;
+    return -1;
   }
-  UEDATX = keyboard_modifier_keys;
-  UEDATX = 0;
-  for (i=0; i<6; i++) {
-    UEDATX = keyboard_keys[i];
+  while (len--) {
+    debug_ring[head++] = *data++;
   }
-  UEINTX = 0x3A;
-  keyboard_idle_count = 0;
+  debug_head = head;
+  debug_flush_timer = 2;
   SREG = intr_state;
   return 0;
 }
 
+// transmit a character.  0 returned on success, -1 on error
+int8_t usb_debug_putchar(uint8_t c)
+{
+  return usb_debug_write(&c, 1);
+}
+
+// transmit any buffered output on the next frame.
+void usb_debug_flush_output(void)
+{
+  uint8_t intr_state;
+
+  intr_state = SREG;
+  cli();
+  if (debug_flush_timer) debug_flush_timer = 1;
+  SREG = intr_state;
+}
+
 /**************************************************************************
  *
  *  Private Functions - not intended for general user consumption....
@@ -349,7 +635,7 @@ int8_t usb_keyboard_send(void)
 //
 ISR(USB_GEN_vect)
 {
-  uint8_t intbits, t, i;
+  uint8_t intbits, t, idle, last, ep;
   static uint8_t div4=0;
 
   intbits = UDINT;
@@ -361,20 +647,29 @@ ISR(USB_GEN_vect)
     UECFG1X = EP_SIZE(ENDPOINT0_SIZE) | EP_SINGLE_BUFFER;
     UEIENX = (1<<RXSTPE);
     usb_configuration = 0;
+    keyboard_protocol = 1;
+    report_tail = report_head;
+  }
+  if (intbits & (1<<SOFI)) {
+    hal_scan_sync();
   }
   if ((intbits & (1<<SOFI)) && usb_configuration) {
-    if (keyboard_idle_config && (++div4 & 3) == 0) {
-      UENUM = KEYBOARD_ENDPOINT;
-      if (UEINTX & (1<<RWAL)) {
+    // full packets go out as soon as they are full, the rest once
+    // nothing has been written for a couple of frames
+    t = debug_flush_timer;
+    if (t) debug_flush_timer = t - 1;
+    usb_debug_drain(t <= 1);
+    usb_keyboard_drain();
+    idle = keyboard_protocol ? nkro_idle_config : keyboard_idle_config;
+    if (idle && (++div4 & 3) == 0 && report_tail == report_head) {
+      last = (report_head - 1) & (REPORT_RING-1);
+      ep = keyboard_protocol ? NKRO_ENDPOINT : KEYBOARD_ENDPOINT;
+      UENUM = ep;
+      if (ep == report_ring[last].endpoint && (UEINTX & (1<<RWAL))) {
 	keyboard_idle_count++;
-	if (keyboard_idle_count == keyboard_idle_config) {
+	if (keyboard_idle_count == idle) {
 	  keyboard_idle_count = 0;
-	  UEDATX = keyboard_modifier_keys;
-	  UEDATX = 0;
-	  for (i=0; i<6; i++) {
-	    UEDATX = keyboard_keys[i];
-	  }
-	  UEINTX = 0x3A;
+	  usb_keyboard_write(last);
 	}
       }
     }
@@ -401,6 +696,30 @@ static inline void usb_ack_out(void)
   UEINTX = ~(1<<RXOUTI);
 }
 
+// Answer a control IN request with a report of size bytes, or
+// zeros when data is NULL.  wLength is clamped before it is
+// narrowed, a host may ask for more than 255 bytes.
+static void usb_send_control(const uint8_t *data, uint8_t size, uint16_t wLength)
+{
+  uint8_t i, n, len;
+
+  len = wLength < size ? wLength : size;
+  do {
+    // wait for host ready for IN packet
+    do {
+      i = UEINTX;
+    } while (!(i & ((1<<TXINI)|(1<<RXOUTI))));
+    if (i & (1<<RXOUTI)) return;    // abort
+    // send IN packet
+    n = len < ENDPOINT0_SIZE ? len : ENDPOINT0_SIZE;
+    for (i = n; i; i--) {
+      UEDATX = data ? *data++ : 0;
+    }
+    len -= n;
+    usb_send_in();
+  } while (len || n == ENDPOINT0_SIZE);
+}
+
 
 
 // USB Endpoint Interrupt - endpoint 0 is handled here.  The
@@ -421,6 +740,8 @@ ISR(USB_COM_vect)
   uint16_t desc_val;
   const uint8_t *desc_addr;
   uint8_t desc_length;
+  uint8_t stats_buf[STATS_REPORT_SIZE];
+  uint8_t remap_buf[REMAP_REPORT_SIZE];
 
   UENUM = 0;
   intbits = UEINTX;
@@ -580,9 +901,99 @@ ISR(USB_COM_vect)
 	}
 	if (bRequest == HID_SET_PROTOCOL) {
 	  keyboard_protocol = wValue;
+	  keyboard_idle_count = 0;
+	  usb_send_in();
+	  return;
+	}
+      }
+    }
+    if (wIndex == NKRO_INTERFACE) {
+      if (bmRequestType == 0xA1) {
+	if (bRequest == HID_GET_REPORT) {
+	  usb_wait_in_ready();
+	  for (i=0; i<NKRO_KEYS_BYTES; i++) {
+	    UEDATX = keyboard_nkro[i];
+	  }
+	  UEDATX = keyboard_modifier_keys;
 	  usb_send_in();
 	  return;
 	}
+	if (bRequest == HID_GET_IDLE) {
+	  usb_wait_in_ready();
+	  UEDATX = nkro_idle_config;
+	  usb_send_in();
+	  return;
+	}
+      }
+      if (bmRequestType == 0x21) {
+	if (bRequest == HID_SET_IDLE) {
+	  nkro_idle_config = (wValue >> 8);
+	  keyboard_idle_count = 0;
+	  usb_send_in();
+	  return;
+	}
+      }
+    }
+    if (wIndex == DEBUG_INTERFACE) {
+      if (bRequest == HID_GET_REPORT && bmRequestType == 0xA1) {
+	// the feature report is the timing statistics, the input
+	// report reads as zeros
+	if ((wValue >> 8) == HID_REPORT_FEATURE) {
+	  stats_report(stats_buf);
+	  usb_send_control(stats_buf, STATS_REPORT_SIZE, wLength);
+	} else {
+	  usb_send_control(NULL, DEBUG_TX_SIZE, wLength);
+	}
+	return;
+      }
+      if (bRequest == HID_SET_REPORT && bmRequestType == 0x21
+	  && (wValue >> 8) == HID_REPORT_FEATURE && wLength
+	  && wLength <= STATS_REPORT_SIZE) {
+	// first byte is a command, the rest is ignored
+	len = wLength;
+	en = 0;
+	do {
+	  usb_wait_receive_out();
+	  if (len == wLength) en = UEDATX;
+	  n = len < ENDPOINT0_SIZE ? len : ENDPOINT0_SIZE;
+	  len -= n;
+	  usb_ack_out();
+	} while (len);
+	if (en == STATS_CMD_RESET) stats_reset();
+	usb_send_in();
+	return;
+      }
+    }
+    if (wIndex == REMAP_INTERFACE) {
+      if (bRequest == HID_GET_REPORT && bmRequestType == 0xA1) {
+	// the feature report is the reply to the last command, the
+	// input report reads as zeros
+	if ((wValue >> 8) == HID_REPORT_FEATURE) {
+	  remap_reply(remap_buf);
+	  usb_send_control(remap_buf, REMAP_REPORT_SIZE, wLength);
+	} else {
+	  usb_send_control(NULL, REMAP_SIZE, wLength);
+	}
+	return;
+      }
+      if (bRequest == HID_SET_REPORT && bmRequestType == 0x21
+	  && (wValue >> 8) == HID_REPORT_FEATURE && wLength
+	  && wLength <= REMAP_REPORT_SIZE) {
+	// a command, handed to the main loop, short reports padded
+	// with zeros
+	for (i=0; i<REMAP_REPORT_SIZE; i++) remap_buf[i] = 0;
+	len = wLength;
+	en = 0;
+	do {
+	  usb_wait_receive_out();
+	  n = len < ENDPOINT0_SIZE ? len : ENDPOINT0_SIZE;
+	  for (i = n; i; i--) remap_buf[en++] = UEDATX;
+	  len -= n;
+	  usb_ack_out();
+	} while (len);
+	remap_request(remap_buf);
+	usb_send_in();
+	return;
       }
     }
   }
@@ -6,17 +6,22 @@
 void usb_init(void);                    // initialize everything
 uint8_t usb_configured(void);           // is the USB port configured
 
-int8_t usb_keyboard_press(uint8_t key, uint8_t modifier);
 int8_t usb_keyboard_send(void);
+uint8_t usb_frame(void);                // low byte of the USB frame number, counts ms
 extern uint8_t keyboard_modifier_keys;
 extern uint8_t keyboard_keys[6];
 extern volatile uint8_t keyboard_leds;
 
-// This file does not include the HID debug functions, so these empty
-// macros replace them with nothing, so users can compile code that
-// has calls to these functions.
-#define usb_debug_putchar(c)
-#define usb_debug_flush_output()
+// usages 0-0xDF, one bit each; 0xE0-0xE7 are keyboard_modifier_keys
+#define NKRO_KEYS_BYTES 28
+extern uint8_t keyboard_nkro[NKRO_KEYS_BYTES];
+
+// The debug interface is a second HID device in the same stack, read on
+// the host with hid_listen.
+int8_t usb_debug_write(const uint8_t *data, uint8_t len); // queue bytes, never waits
+int8_t usb_debug_putchar(uint8_t c);    // transmit a character
+void usb_debug_flush_output(void);      // transmit buffered output next frame
+#define USB_DEBUG_HID
 
 #define KEY_CTRL        0x01
 #define KEY_SHIFT       0x02
@@ -285,7 +290,7 @@ extern volatile uint8_t keyboard_leds;
 
 
 // Everything below this point is only intended for usb_serial.c
-//#ifdef USB_SERIAL_PRIVATE_INCLUDE
+#ifdef USB_SERIAL_PRIVATE_INCLUDE
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
@@ -347,9 +352,13 @@ extern volatile uint8_t keyboard_leds;
 #define HID_SET_REPORT                  9
 #define HID_SET_IDLE                    10
 #define HID_SET_PROTOCOL                11
+// HID report types, the high byte of wValue in GET/SET_REPORT
+#define HID_REPORT_INPUT                1
+#define HID_REPORT_OUTPUT               2
+#define HID_REPORT_FEATURE              3
 // CDC (communication class device)
 #define CDC_SET_LINE_CODING             0x20
 #define CDC_GET_LINE_CODING             0x21
 #define CDC_SET_CONTROL_LINE_STATE      0x22
 #endif
-//#endif
+#endif
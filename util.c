@@ -1,5 +1,3 @@
-#include <avr/io.h>
-#include <avr/pgmspace.h>
 #include "util.h"
 
 double add(double cnt, double delt) {
@@ -29,3 +27,36 @@ int getGreen(unsigned long int hex) {
 int getBlue(unsigned long int hex) {
   return(hex & 0xFF);
 }
+
+/* Six sectors of hue, h*6 puts the sector in the high byte and the
+   position within it in the low byte.  Per sector one channel is at v,
+   one at the floor p and one ramps between them, so the whole conversion
+   is a handful of 8x8 multiplies. */
+void hsvToRgb(Hsv hsv, uint8_t rgb[]) {
+  uint16_t h6 = hsv.h * 6;
+  uint8_t f = h6 & 0xFF;
+  uint8_t v = hsv.v;
+  uint8_t p = scale8(v, 255 - hsv.s);
+  uint8_t q = scale8(v, 255 - scale8(hsv.s, f));          // falling
+  uint8_t t = scale8(v, 255 - scale8(hsv.s, 255 - f));    // rising
+  uint8_t r, g, b;
+
+  switch(h6 >> 8) {
+    case 0:  r = v; g = t; b = p; break;
+    case 1:  r = q; g = v; b = p; break;
+    case 2:  r = p; g = v; b = t; break;
+    case 3:  r = p; g = q; b = v; break;
+    case 4:  r = t; g = p; b = v; break;
+    default: r = v; g = p; b = q; break;
+  }
+  rgb[0] = r;
+  rgb[1] = g;
+  rgb[2] = b;
+}
+
+uint16_t crc16_update(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for(uint8_t i=0; i<8; i++)
+    crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  return crc;
+}
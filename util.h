@@ -5,6 +5,8 @@
 #ifndef __UTIL__
 #define __UTIL__
 
+#include <stdint.h>
+
 typedef enum { false, true } bool;
 
 double add(double, double);
@@ -20,4 +22,21 @@ int getRed(unsigned long int);
 int getGreen(unsigned long int);
 
 int getBlue(unsigned long int);
+
+/* A colour as hue, saturation and value, 0-255 each.  Hue runs red 0,
+   yellow 43, green 85, cyan 128, blue 171, purple 213 and back to red. */
+typedef struct {
+  uint8_t h, s, v;
+} Hsv;
+
+// a * b/255, exact at 0 and 255, one 8x8 multiply and no division
+static inline uint8_t scale8(uint8_t a, uint8_t b) {
+  return ((uint16_t)a * (b + 1)) >> 8;
+}
+
+// convert to 8 bit red, green, blue in rgb[0..2]
+void hsvToRgb(Hsv hsv, uint8_t rgb[]);
+
+// CRC-16/CCITT (polynomial 0x1021) of one more byte, start from 0xFFFF
+uint16_t crc16_update(uint16_t crc, uint8_t data);
 #endif